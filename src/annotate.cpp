@@ -34,7 +34,7 @@ const FileAnnotation* Annotate::lookupAnnotation(SCRef sha)
     if (!valid || sha.isEmpty())
         return NULL;
 
-    AnnotateHistory::const_iterator it = ah.constFind(toTempSha(sha));
+    AnnotateHistory::const_iterator it = ah.constFind(ShaString(sha));
     if (it != ah.constEnd())
         return &(it.value());
 
@@ -43,7 +43,7 @@ const FileAnnotation* Annotate::lookupAnnotation(SCRef sha)
     const QString ancestorSha = getAncestor(sha, &shaIdx);
 
     if (!ancestorSha.isEmpty()) {
-        it = ah.constFind(toTempSha(ancestorSha));
+        it = ah.constFind(ShaString(ancestorSha));
         if (it != ah.constEnd())
             return &(it.value());
     }
@@ -204,7 +204,7 @@ void Annotate::doAnnotate(const ShaString& ss) {
 
 FileAnnotation* Annotate::getFileAnnotation(SCRef sha)
 {
-    AnnotateHistory::iterator it(ah.find(toTempSha(sha)));
+    AnnotateHistory::iterator it(ah.find(ShaString(sha)));
 
     if (it == ah.end()) {
         dbp("ASSERT getFileAnnotation: no revision %1", sha);
@@ -370,21 +370,21 @@ bool Annotate::setAnnotation(SCRef diff, SCRef author, SCList prevAnn, SList new
 
 const QString Annotate::getPatch(SCRef sha, int parentNum)
 {
-    QString mergeSha(sha);
-
-    if (parentNum)
-        mergeSha = QString::number(parentNum) + " m " + sha;
-
-    const Revision* r = git->revLookup(mergeSha, fh);
-
+    const ShaString ss(sha);
+    const Revision* r = NULL;
+
+    if (!parentNum)
+        r = git->revLookup(ss, fh);
+    else { // merges are split in one revision per parent
+        const QVector<const Revision*>& v = fh->mergeRevs.value(ss);
+        if (parentNum <= v.count())
+            r = v.at(parentNum - 1);
+    }
     if (!r)
         return QString();
 
     const QString diff(r->diff());
 
-    QVector<QByteArray> ba;
-    const ShaString& ss = toPersistentSha(sha, ba);
-
     if (ah[ss].fileSha.isEmpty() && !parentNum) {
         int idx = diff.indexOf("..");
 
@@ -714,6 +714,11 @@ bool Annotate::isDescendant(SCRef sha, SCRef target)
     // from target, sha could be reached walking along his parents. In case
     // a merge is found the search returns false because you'll need,
     // in general, all the previous ranges to compute the target one.
+    // Not related revisions are ruled out at once by the tree index,
+    // if ready, otherwise the walk below is enough to tell.
+    bool isAnc;
+    if (target.isEmpty() || (git->ancestryFromIndex(sha, target, &isAnc) && !isAnc))
+        return false;
 
     const Revision* r = git->revLookup(sha, fh);
     if (!r)
@@ -752,8 +757,7 @@ const QString Annotate::computeRanges(SCRef sha, int paraFrom, int paraTo, SCRef
 
     QString ancestor(sha);
     int shaIdx;
-    QVector<QByteArray> ba;
-    const ShaString& ss = toPersistentSha(sha, ba);
+    const ShaString ss(sha);
     for (shaIdx = 0; shaIdx < histRevOrder.count(); shaIdx++)
         if (histRevOrder[shaIdx] == ss)
             break;
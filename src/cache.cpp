@@ -1,223 +1,708 @@
 /*
-    Description: file names persistent cache
+    Description: file names and revisions persistent caches
 
     Author: Marco Costalba (C) 2005-2007
 
     Copyright: See COPYING file that comes with this distribution
 
 */
+#include <string.h>
 #include <QFile>
 #include <QDir>
+#include <QPair>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+#include <QtEndian>
 #include "cache.h"
+#include "lz4codec.h"
 
 using namespace QGit;
 
-Cache::Cache(QObject *parent) : QObject(parent)
+static bool replaceFile(SCRef tmpPath, SCRef path) {
+
+    // rename path + BAK_EXT -> path
+    QDir dir;
+    if (dir.exists(path)) {
+        if (!dir.remove(path)) {
+            dbs("access denied to " + path);
+            dir.remove(tmpPath);
+            return false;
+        }
+    }
+    return dir.rename(tmpPath, path);
+}
+
+#define SEGMENT_MAGIC  0xC0DE5E61
+#define SHA_ENTRY_SIZE (ShaString::RAW_SIZE + 4) // raw sha + record offset
+
+enum RecordFlags {
+    ONLY_MODIFIED    = 1,
+    HAS_STATUS       = 2,
+    HAS_MERGE_PARENT = 4,
+    HAS_EXT_STATUS   = 8
+};
+
+static inline void put32(QByteArray& b, quint32 v) {
+
+    b.append((const char*)&v, sizeof(v));
+}
+
+static inline void putStr(QByteArray& b, SCRef s) {
+
+    const QByteArray utf(s.toUtf8());
+    put32(b, utf.size());
+    b.append(utf);
+}
+
+static inline bool shaLessThan(const ShaString& a, const ShaString& b) {
+
+    return memcmp(a.rawData(), b.rawData(), ShaString::RAW_SIZE) < 0;
+}
+
+struct Reader // bounds checked reads of mapped data, that could be not aligned
 {
+    Reader(const uchar* p, const uchar* e) : cur(p), end(e), ok(true) {}
+
+    const uchar* array(quint32 n, int itemSize) {
+
+        if (!ok || n > quint32(end - cur) / itemSize) {
+            ok = false;
+            return NULL;
+        }
+        const uchar* p = cur;
+        cur += n * itemSize;
+        return p;
+    }
+    quint32 u32() {
 
+        quint32 v = 0;
+        const uchar* p = array(1, sizeof(v));
+        if (p)
+            memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    const QString str() {
+
+        quint32 len = u32();
+        const uchar* p = array(len, 1);
+        return (p ? QString::fromUtf8((const char*)p, len) : "");
+    }
+    const uchar* cur;
+    const uchar* end;
+    bool ok;
+};
+
+Cache::Cache(QObject *parent) : QObject(parent)
+{
+    data = NULL;
+    dataSize = validSize = 0;
+    dirsCnt = filesCnt = 0;
+    mapPending = false;
 }
 
-bool Cache::save(const QString& gitDir, const RevFileMap& rf, const StrVect& dirs,
-                 const StrVect& files)
+Cache::~Cache()
 {
-    if (gitDir.isEmpty() || rf.isEmpty())
-        return false;
+    close(); // waits for a pending save
+}
 
-    QString path(gitDir + C_DAT_FILE);
-    QString tmpPath(path + BAK_EXT);
+bool Cache::open(const QString& gitDir, StrVect& dirs, StrVect& files)
+{
+    close();
+    dirs.clear();
+    files.clear();
+    file.setFileName(gitDir + C_DAT_FILE);
+    if (!file.exists())
+        return true; // no cache file is not an error
 
-    QDir dir;
-    if (!dir.exists(gitDir)) {
-        dbs("Git directory not found, unable to save cache");
+    if (!file.open(QIODevice::ReadOnly) || !map()) {
+        close();
         return false;
     }
-    QFile f(tmpPath);
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Unbuffered))
-        return false;
+    if (!scan(&dirs, &files))
+        dbs("File names cache has an old format, it will be rebuilt");
 
-    dbs("Saving cache. Please wait...");
+    return true;
+}
 
-    // compress in memory before write to file
-    QByteArray data;
-    QDataStream stream(&data, QIODevice::WriteOnly);
+void Cache::close()
+{
+    saving.waitForFinished();
+    mapPending = false;
+    unmap();
+    validSize = 0;
+    dirsCnt = filesCnt = 0;
+}
 
-    // Write a header with a "magic number" and a version
-    stream << (quint32)C_MAGIC;
-    stream << (qint32)C_VERSION;
+void Cache::sync()
+{
+    if (!mapPending)
+        return;
 
-    stream << (qint32)dirs.count();
-    for (int i = 0; i < dirs.count(); ++i)
-        stream << dirs.at(i);
+    mapPending = false;
+    saving.waitForFinished();
+    if (!saving.result())
+        dbs("ERROR unable to save file names cache");
 
-    stream << (qint32)files.count();
-    for (int i = 0; i < files.count(); ++i)
-        stream << files.at(i);
+    if (file.open(QIODevice::ReadOnly) && map())
+        scan(NULL, NULL);
+}
 
-    // to achieve a better compression we save the sha's as
-    // one very long string instead of feeding the stream with
-    // each one. With this trick we gain a 15% size reduction
-    // in the final compressed file. The save/load speed is
-    // almost the same.
-    uint bufSize = rf.count() * 41 + 1000; // a little bit more space then required
+bool Cache::map()
+{
+    dataSize = file.size();
+    data = (dataSize > 0 ? file.map(0, dataSize) : NULL);
+    if (!data) { // mapping not supported, read it all
+        fileData = file.readAll();
+        data = (const uchar*)fileData.constData();
+        return (fileData.size() == dataSize);
+    }
+    return true;
+}
 
-    QByteArray buf;
-    buf.reserve(bufSize);
+void Cache::unmap()
+{
+    if (data && fileData.isEmpty())
+        file.unmap(const_cast<uchar*>(data));
+
+    fileData.clear();
+    data = NULL;
+    dataSize = 0;
+    segments.clear();
+    file.close();
+}
 
-    QVector<const RevFile*> v;
-    v.reserve(rf.count());
+qint64 Cache::parseSegments(const uchar* data, qint64 size, QVector<Segment>& segs)
+{
+/*
+   Returns the size of the valid part of the file, 0 if it has not our
+   format. A truncated or corrupted segment, as example due to a crash
+   while saving, and everything after it is ignored and will be
+   overwritten at next append().
+*/
+    Reader r(data, data + size);
+    if (r.u32() != C_MAGIC || r.u32() != (quint32)C_VERSION)
+        return 0;
+
+    qint64 validSize = r.cur - data;
+    quint32 dirsCnt = 0, filesCnt = 0;
+    while (r.cur < r.end && r.u32() == SEGMENT_MAGIC) {
+
+        quint32 segSize = r.u32();
+        const uchar* segStart = r.array(segSize, 1);
+        if (!segStart)
+            break;
+
+        Reader s(segStart, segStart + segSize);
+        Segment seg;
+        quint32 dirsBase = s.u32();
+        seg.dirsNum = s.u32();
+        quint32 filesBase = s.u32();
+        seg.filesNum = s.u32();
+        if (!s.ok || dirsBase != dirsCnt || filesBase != filesCnt)
+            break;
+
+        seg.names = s.cur;
+        for (quint32 i = 0; i < seg.dirsNum + seg.filesNum && s.ok; i++)
+            s.array(s.u32(), 1);
+
+        seg.namesEnd = s.cur;
+        seg.count = s.u32();
+        seg.index = s.array(seg.count, SHA_ENTRY_SIZE);
+        seg.records = s.cur;
+        seg.end = s.end;
+        if (!s.ok)
+            break;
+
+        segs.append(seg);
+        dirsCnt += seg.dirsNum;
+        filesCnt += seg.filesNum;
+        validSize = seg.end - data;
+    }
+    return validSize;
+}
 
-    QVector<QByteArray> ba;
-    ShaString CUSTOM_SHA_RAW(toPersistentSha(CUSTOM_SHA, ba));
-    unsigned int newSize = 0;
+bool Cache::scan(StrVect* dirs, StrVect* files)
+{
+    // names are read only if 'dirs' and 'files' are given
+    segments.clear();
+    dirsCnt = filesCnt = 0;
+    validSize = parseSegments(data, dataSize, segments);
 
-    FOREACH (RevFileMap, it, rf) {
+    for (int i = 0; i < segments.count(); i++) {
 
-        const ShaString& sha = it.key();
-        if (   sha == ZERO_SHA_RAW
-            || sha == CUSTOM_SHA_RAW
-            || sha.latin1()[0] == 'A') // ALL_MERGE_FILES + rev sha
+        const Segment& seg = segments.at(i);
+        dirsCnt += seg.dirsNum;
+        filesCnt += seg.filesNum;
+        if (!dirs || !files)
             continue;
 
-        v.append(it.value());
-        buf.append(sha.latin1()).append('\0');
-        newSize += 41;
-        if (newSize > bufSize) {
-            dbs("ASSERT in Cache::save, out of allocated space");
-            return false;
+        Reader r(seg.names, seg.namesEnd);
+        for (quint32 j = 0; j < seg.dirsNum; j++)
+            dirs->append(r.str());
+
+        for (quint32 j = 0; j < seg.filesNum; j++)
+            files->append(r.str());
+    }
+    return (validSize > 0);
+}
+
+const uchar* Cache::findRecord(const ShaString& sha, const uchar** end) const
+{
+    // segments are few, one for each save, and each one has a sorted index
+    for (int i = segments.count() - 1; i >= 0; i--) {
+
+        const Segment& seg = segments.at(i);
+        int lo = 0, hi = seg.count;
+        while (lo < hi) {
+
+            int mid = (lo + hi) / 2;
+            const uchar* entry = seg.index + mid * SHA_ENTRY_SIZE;
+            int cmp = memcmp(entry, sha.rawData(), ShaString::RAW_SIZE);
+            if (cmp < 0)
+                lo = mid + 1;
+            else if (cmp > 0)
+                hi = mid;
+            else {
+                quint32 ofs;
+                memcpy(&ofs, entry + ShaString::RAW_SIZE, sizeof(ofs));
+                if (ofs >= quint32(seg.end - seg.records))
+                    return NULL;
+
+                if (end)
+                    *end = seg.end;
+                return seg.records + ofs;
+            }
         }
     }
-    buf.resize(newSize);
-    stream << (qint32)newSize;
-    stream << buf;
+    return NULL;
+}
 
-    for (int i = 0; i < v.size(); ++i)
-        *(v.at(i)) >> stream;
+RevFile* Cache::decode(const ShaString& sha)
+{
+    sync();
 
-    dbs("Compressing data...");
-    f.write(qCompress(data, 1)); // no need to encode with compressed data
-    f.close();
+    const uchar* end;
+    const uchar* rec = findRecord(sha, &end);
+    if (!rec)
+        return NULL;
 
-    // rename C_DAT_FILE + BAK_EXT -> C_DAT_FILE
-    if (dir.exists(path)) {
-        if (!dir.remove(path)) {
-            dbs("access denied to " + path);
-            dir.remove(tmpPath);
-            return false;
-        }
+    Reader r(rec, end);
+    RevFile* rf = new RevFile();
+
+    quint32 size = r.u32();
+    const uchar* paths = r.array(size, 1);
+    if (paths)
+        rf->pathsIdx = QByteArray((const char*)paths, size);
+
+    quint32 flags = r.u32();
+    rf->onlyModified = (flags & ONLY_MODIFIED);
+
+    if (flags & HAS_STATUS) {
+        quint32 n = r.u32();
+        const uchar* p = r.array(n, 1);
+        for (quint32 i = 0; p && i < n; i++)
+            rf->status.append(p[i]);
     }
-    dir.rename(tmpPath, path);
-    dbs("Done.");
-    return true;
+    if (flags & HAS_MERGE_PARENT) {
+        quint32 n = r.u32();
+        for (quint32 i = 0; i < n && r.ok; i++)
+            rf->mergeParent.append(r.u32());
+    }
+    if (flags & HAS_EXT_STATUS) {
+        quint32 n = r.u32();
+        for (quint32 i = 0; i < n && r.ok; i++)
+            rf->extStatus.append(r.str());
+    }
+    if (!r.ok || size % (2 * sizeof(int))) {
+        dbp("ASSERT in Cache::decode, corrupted record for %1", sha.toString());
+        delete rf;
+        return NULL;
+    }
+    return rf;
 }
 
-bool Cache::load(const QString& gitDir, RevFileMap& rfm, StrVect& dirs, StrVect& files,
-                 QByteArray& revsFilesShaBuf)
+bool Cache::paths(const ShaString& sha, QByteArray& pathsIdx)
 {
-    // check for cache file
-    QString path(gitDir + C_DAT_FILE);
-    QFile f(path);
-    if (!f.exists())
-        return true; // no cache file is not an error
+    // same of decode() but only paths are read, nothing is allocated
+    // for the other fields. Used to index cached revisions by path
+    sync();
 
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+    const uchar* end;
+    const uchar* rec = findRecord(sha, &end);
+    if (!rec)
         return false;
 
-    QDataStream stream(qUncompress(f.readAll()));
-    quint32 magic;
-    qint32 version;
-    qint32 dirsNum, filesNum, bufSize;
-    stream >> magic;
-    stream >> version;
-    if (magic != C_MAGIC || version != C_VERSION) {
-        f.close();
+    Reader r(rec, end);
+    quint32 size = r.u32();
+    const uchar* p = r.array(size, 1);
+    if (!r.ok || size % (2 * sizeof(int)))
         return false;
-    }
-    // read the data
-    stream >> dirsNum;
-    dirs.resize(dirsNum);
-    for (int i = 0; i < dirsNum; ++i)
-        stream >> dirs[i];
 
-    stream >> filesNum;
-    files.resize(filesNum);
-    for (int i = 0; i < filesNum; ++i)
-        stream >> files[i];
+    pathsIdx = QByteArray((const char*)p, size);
+    return true;
+}
 
-    stream >> bufSize;
-    revsFilesShaBuf.clear();
-    revsFilesShaBuf.reserve(bufSize);
-    stream >> revsFilesShaBuf;
+bool Cache::append(const RevFileMap& rfm, const StrVect& dirs, const StrVect& files)
+{
+/*
+   Builds a new segment with the names and the revisions not yet in
+   file, so saving time depends only on what is new in this session,
+   then a worker thread writes it. Already decoded revisions stay valid
+   because they don't point into mapped data.
+*/
+    sync();
+    if (file.fileName().isEmpty())
+        return false;
 
-    const char* data = revsFilesShaBuf.constData();
+    QVector<ShaString> shas;
+    FOREACH (RevFileMap, it, rfm)
+        if (it.key() != ZERO_SHA_RAW && !contains(it.key()))
+            shas.append(it.key());
 
-    while (!stream.atEnd()) {
+    if (shas.isEmpty() && dirs.count() == dirsCnt && files.count() == filesCnt)
+        return true;
 
-        RevFile* rf = new RevFile();
-        *rf << stream;
+    qSort(shas.begin(), shas.end(), shaLessThan);
 
-        ShaString sha(data);
-        rfm.insert(sha, rf);
+    QByteArray seg, index, records;
+    put32(seg, dirsCnt);
+    put32(seg, dirs.count() - dirsCnt);
+    put32(seg, filesCnt);
+    put32(seg, files.count() - filesCnt);
 
-        data += 40;
-        if (*data != '\0') {
-            dbp("ASSERT in Cache::load, corrupted SHA after %1", sha);
-            return false;
+    for (int i = dirsCnt; i < dirs.count(); i++)
+        putStr(seg, dirs.at(i));
+
+    for (int i = filesCnt; i < files.count(); i++)
+        putStr(seg, files.at(i));
+
+    for (int i = 0; i < shas.count(); i++) {
+
+        const RevFile* rf = rfm.value(shas.at(i));
+        index.append(shas.at(i).rawData(), ShaString::RAW_SIZE);
+        put32(index, records.size());
+
+        put32(records, rf->pathsIdx.size());
+        records.append(rf->pathsIdx);
+
+        // skip common cases of only modified files, just
+        // one parent and no renames or copies
+        bool hasMergeParent = !(rf->mergeParent.isEmpty() || rf->mergeParent.last() == 1);
+        quint32 flags = (rf->onlyModified ? ONLY_MODIFIED : HAS_STATUS);
+        flags |= (hasMergeParent ? HAS_MERGE_PARENT : 0);
+        flags |= (!rf->extStatus.isEmpty() ? HAS_EXT_STATUS : 0);
+        put32(records, flags);
+
+        if (flags & HAS_STATUS) {
+            put32(records, rf->status.count());
+            for (int j = 0; j < rf->status.count(); j++)
+                records.append((char)rf->status.at(j)); // flags fit in a byte
+        }
+        if (flags & HAS_MERGE_PARENT) {
+            put32(records, rf->mergeParent.count());
+            for (int j = 0; j < rf->mergeParent.count(); j++)
+                put32(records, rf->mergeParent.at(j));
+        }
+        if (flags & HAS_EXT_STATUS) {
+            put32(records, rf->extStatus.count());
+            for (int j = 0; j < rf->extStatus.count(); j++)
+                putStr(records, rf->extStatus.at(j));
         }
-        data++;
     }
-    f.close();
+    put32(seg, shas.count());
+    seg.append(index).append(records);
+
+    // names are now in file, also if saving fails the file
+    // is then discarded, so no need to wait the worker here
+    dirsCnt = dirs.count();
+    filesCnt = files.count();
+
+    bool needsCompaction = (segments.count() + 1 > MAX_CACHE_SEGMENTS);
+    qint64 ofs = validSize;
+    unmap(); // the worker could replace the file
+    saving = QtConcurrent::run(&Cache::write, file.fileName(), ofs, seg, needsCompaction);
+    mapPending = true;
     return true;
 }
 
-/*
- * RevFile class streaming functions
- */
-const RevFile& RevFile::operator>>(QDataStream& stream) const
+bool Cache::write(const QString& path, qint64 ofs, const QByteArray& seg, bool compaction)
 {
-    stream << pathsIdx;
+// called in a worker thread, appends 'seg' at 'ofs'
+
+    QFile f(path);
+    if (!f.open(QIODevice::ReadWrite | QIODevice::Unbuffered))
+        return false;
+
+    QByteArray buf;
+    if (ofs == 0) { // missing, old format or corrupted, start from scratch
+        put32(buf, C_MAGIC);
+        put32(buf, C_VERSION);
+    }
+    put32(buf, SEGMENT_MAGIC);
+    put32(buf, seg.size());
+    buf.append(seg);
+
+    bool ok =    f.resize(ofs) // drop any garbage tail
+              && f.seek(ofs)
+              && f.write(buf) == buf.size();
+    if (!ok)
+        f.resize(ofs);
+
+    f.close();
+    return (ok && (!compaction || compact(path)));
+}
+
+bool Cache::compact(const QString& path)
+{
+/*
+   Called in a worker thread, merges all the segments in a single one.
+   Names are just concatenated, they are already numbered in order,
+   while sha indexes are merged and records offsets moved.
+*/
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    const QByteArray all(f.readAll());
+    f.close();
+
+    QVector<Segment> segs;
+    const uchar* data = (const uchar*)all.constData();
+    if (!parseSegments(data, all.size(), segs))
+        return false;
+
+    QByteArray names, records;
+    QVector<QPair<QByteArray, quint32> > entries; // (raw sha, record offset)
+    quint32 dirsNum = 0, filesNum = 0;
+
+    for (int i = 0; i < segs.count(); i++) { // dirs of all segments first
+        Reader r(segs.at(i).names, segs.at(i).namesEnd);
+        for (quint32 j = 0; j < segs.at(i).dirsNum; j++)
+            r.array(r.u32(), 1);
+
+        names.append((const char*)segs.at(i).names, r.cur - segs.at(i).names);
+        dirsNum += segs.at(i).dirsNum;
+    }
+    for (int i = 0; i < segs.count(); i++) { // then files
+        Reader r(segs.at(i).names, segs.at(i).namesEnd);
+        for (quint32 j = 0; j < segs.at(i).dirsNum; j++)
+            r.array(r.u32(), 1);
+
+        names.append((const char*)r.cur, segs.at(i).namesEnd - r.cur);
+        filesNum += segs.at(i).filesNum;
+    }
+    for (int i = 0; i < segs.count(); i++) {
+
+        const Segment& seg = segs.at(i);
+        quint32 base = records.size();
+        for (int j = 0; j < seg.count; j++) {
+            const uchar* entry = seg.index + j * SHA_ENTRY_SIZE;
+            quint32 ofs;
+            memcpy(&ofs, entry + ShaString::RAW_SIZE, sizeof(ofs));
+            entries.append(qMakePair(QByteArray((const char*)entry, ShaString::RAW_SIZE), base + ofs));
+        }
+        records.append((const char*)seg.records, seg.end - seg.records);
+    }
+    qSort(entries); // raw sha compare as memcmp does
+
+    QByteArray seg;
+    put32(seg, 0);
+    put32(seg, dirsNum);
+    put32(seg, 0);
+    put32(seg, filesNum);
+    seg.append(names);
+    put32(seg, entries.count());
+    for (int i = 0; i < entries.count(); i++) {
+        seg.append(entries.at(i).first);
+        put32(seg, entries.at(i).second);
+    }
+    seg.append(records);
 
-    // skip common case of only modified files
-    bool isEmpty = onlyModified;
-    stream << (quint32)isEmpty;
-    if (!isEmpty)
-        stream << status;
+    QByteArray buf;
+    put32(buf, C_MAGIC);
+    put32(buf, C_VERSION);
+    put32(buf, SEGMENT_MAGIC);
+    put32(buf, seg.size());
+    buf.append(seg);
+
+    const QString tmpPath(path + BAK_EXT);
+    QFile tmp(tmpPath);
+    if (!tmp.open(QIODevice::WriteOnly | QIODevice::Unbuffered))
+        return false;
+
+    bool ok = (tmp.write(buf) == buf.size());
+    tmp.close();
+    if (!ok) {
+        QDir().remove(tmpPath);
+        return false;
+    }
+    return replaceFile(tmpPath, path);
+}
 
-    // skip common case of just one parent
-    isEmpty = (mergeParent.isEmpty() || mergeParent.last() == 1);
-    stream << (quint32)isEmpty;
-    if (!isEmpty)
-        stream << mergeParent;
+struct RevsBlock // a revisions cache block, (de)compressed by a worker thread
+{
+    const char* src;
+    int srcSize;
+    char* dst;         // when loading
+    int dstSize;
+    QByteArray packed; // when saving
+    bool ok;
+};
+
+static void packBlock(RevsBlock& b) {
+
+    b.packed.resize(Lz4::maxCompressedSize(b.srcSize));
+    int size = Lz4::compress(b.src, b.srcSize, b.packed.data());
+    if (size < b.srcSize)
+        b.packed.resize(size);
+    else
+        b.packed = QByteArray(b.src, b.srcSize); // stored as is
+}
 
-    // skip common case of no rename/copies
-    isEmpty = extStatus.isEmpty();
-    stream << (quint32)isEmpty;
-    if (!isEmpty)
-        stream << extStatus;
+static void unpackBlock(RevsBlock& b) {
 
-    return *this;
+    if (b.srcSize == b.dstSize) { // stored block
+        memcpy(b.dst, b.src, b.srcSize);
+        b.ok = true;
+    } else
+        b.ok = Lz4::decompress(b.src, b.srcSize, b.dst, b.dstSize);
 }
 
-RevFile& RevFile::operator<<(QDataStream& stream)
+bool Cache::saveRevs(const QString& gitDir, const QStringList& args, const QStringList& tips,
+                     const QVector<const Revision*>& revs)
 {
-    stream >> pathsIdx;
+/*
+   Revisions are saved as the raw 'git log' records they were parsed
+   from, in loading order, so that at next startup they can be fed to
+   the usual parsing path as they were a (very fast) 'git log' output.
+   Records are already '\0' terminated. Data is split in blocks packed
+   independently with LZ4, so that they can be unpacked in parallel,
+   a block that does not shrink is stored as is.
+*/
+    if (gitDir.isEmpty() || revs.isEmpty())
+        return false;
 
-    bool isEmpty;
-    quint32 tmp;
+    QString path(gitDir + R_DAT_FILE);
+    QString tmpPath(path + BAK_EXT);
 
-    stream >> tmp;
-    onlyModified = (bool)tmp;
-    if (!onlyModified)
-        stream >> status;
+    QDir dir;
+    if (!dir.exists(gitDir)) {
+        dbs("Git directory not found, unable to save revisions cache");
+        return false;
+    }
+    QFile f(tmpPath);
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+
+    qint64 dataSize = 0;
+    for (int i = 0; i < revs.count(); ++i)
+        dataSize += revs.at(i)->rawRecord().size();
 
-    stream >> tmp;
-    isEmpty = (bool)tmp;
-    if (!isEmpty)
-        stream >> mergeParent;
+    QByteArray raw;
+    raw.reserve(dataSize);
+    for (int i = 0; i < revs.count(); ++i)
+        raw.append(revs.at(i)->rawRecord());
 
-    stream >> tmp;
-    isEmpty = (bool)tmp;
-    if (!isEmpty)
-        stream >> extStatus;
+    QVector<RevsBlock> blocks((dataSize + R_BLOCK_SIZE - 1) / R_BLOCK_SIZE);
+    for (int i = 0; i < blocks.count(); ++i) {
+        blocks[i].src = raw.constData() + i * R_BLOCK_SIZE;
+        blocks[i].srcSize = (int)qMin(dataSize - (qint64)i * R_BLOCK_SIZE, (qint64)R_BLOCK_SIZE);
+    }
+    QtConcurrent::blockingMap(blocks, packBlock);
+
+    QDataStream stream(&f);
+    stream << (quint32)R_MAGIC;
+    stream << (qint32)R_VERSION;
+    stream << args;
+    stream << tips;
+    stream << dataSize;
+    stream << (qint32)blocks.count();
+
+    for (int i = 0; i < blocks.count(); ++i) {
+        const QByteArray& b(blocks.at(i).packed);
+        stream << (qint32)b.size();
+        stream.writeRawData(b.constData(), b.size());
+    }
+    bool ok = (stream.status() == QDataStream::Ok);
+    f.close();
 
-    return *this;
+    if (!ok) {
+        dir.remove(tmpPath);
+        return false;
+    }
+    return replaceFile(tmpPath, path);
+}
+
+QByteArray* Cache::loadRevs(const QString& gitDir, const QStringList& args, QStringList& tips)
+{
+// returns the cached records, to be deleted by the caller, and the
+// tips they were loaded from, or NULL if the cache is missing or
+// refers to different loading arguments. A cache with an old format
+// is just ignored, it will be overwritten at next save.
+
+    QFile f(gitDir + R_DAT_FILE);
+    if (!f.exists() || !f.open(QIODevice::ReadOnly))
+        return NULL;
+
+    QDataStream stream(&f);
+    quint32 magic;
+    qint32 version;
+    QStringList cachedArgs;
+    qint64 dataSize;
+    qint32 blocksNum;
+    stream >> magic;
+    stream >> version;
+    if (magic != R_MAGIC || version != R_VERSION)
+        return NULL;
+
+    stream >> cachedArgs;
+    stream >> tips;
+    stream >> dataSize;
+    stream >> blocksNum;
+    if (stream.status() != QDataStream::Ok || cachedArgs != args || tips.isEmpty())
+        return NULL;
+
+    if (   dataSize <= 0
+        || blocksNum != (dataSize + R_BLOCK_SIZE - 1) / R_BLOCK_SIZE) {
+        dbs("ASSERT in Cache::loadRevs, corrupted revisions cache");
+        return NULL;
+    }
+    const QByteArray packed(f.read(f.size() - f.pos()));
+    QByteArray* ba = new QByteArray();
+    ba->resize(dataSize);
+
+    QVector<RevsBlock> blocks(blocksNum);
+    const char* p = packed.constData();
+    const char* end = p + packed.size();
+    bool ok = true;
+    for (int i = 0; i < blocksNum && ok; ++i) {
+
+        qint32 size = 0;
+        ok = (end - p >= (int)sizeof(size));
+        if (ok) {
+            memcpy(&size, p, sizeof(size));
+            size = qFromBigEndian(size); // written by QDataStream
+            p += sizeof(size);
+        }
+        RevsBlock& b = blocks[i];
+        b.src = p;
+        b.srcSize = size;
+        b.dst = ba->data() + i * R_BLOCK_SIZE;
+        b.dstSize = (int)qMin(dataSize - (qint64)i * R_BLOCK_SIZE, (qint64)R_BLOCK_SIZE);
+        ok = ok && size > 0 && size <= b.dstSize && size <= end - p;
+        p += (ok ? size : 0);
+    }
+    if (ok && p == end) {
+        QtConcurrent::blockingMap(blocks, unpackBlock);
+        for (int i = 0; i < blocksNum && ok; ++i)
+            ok = blocks.at(i).ok;
+    } else
+        ok = false;
+
+    if (!ok || ba->at(ba->size() - 1) != '\0') {
+        dbs("ASSERT in Cache::loadRevs, truncated revisions cache");
+        delete ba;
+        return NULL;
+    }
+    return ba;
 }
@@ -7,17 +7,68 @@
 #ifndef CACHE_H
 #define CACHE_H
 
+#include <QFile>
+#include <QFuture>
 #include "git.h"
 
+/*
+   File names cache, saved in qgit_cache.dat. After the header the file
+   is a list of segments, each one appended at save time with only new
+   dir and file names and new revisions. A segment has a string table,
+   a sorted sha index and the revisions records, stored uncompressed and
+   in host byte order so that the file is memory mapped and a RevFile
+   is decoded only when first asked for.
+
+   Writing is done by a worker thread, that also compacts the segments
+   in a single one when they are too many. Any access waits for it.
+*/
 class Cache : public QObject
 {
     Q_OBJECT
 public:
     explicit Cache(QObject* parent);
-    static bool save(const QString &gitDir, const RevFileMap &rf, const StrVect &dirs,
-                     const StrVect &files);
-    static bool load(const QString &gitDir, RevFileMap &rf, StrVect &dirs, StrVect &files,
-                     QByteArray &revsFilesShaBuf);
+    ~Cache();
+    bool open(const QString &gitDir, StrVect &dirs, StrVect &files);
+    void close();
+    bool contains(const ShaString &sha) { sync(); return findRecord(sha) != NULL; }
+    RevFile* decode(const ShaString &sha); // NULL if not cached
+    bool paths(const ShaString &sha, QByteArray &pathsIdx); // RevFile::pathsIdx only
+    bool append(const RevFileMap &rf, const StrVect &dirs, const StrVect &files);
+    static bool saveRevs(const QString &gitDir, const QStringList &args, const QStringList &tips,
+                         const QVector<const Revision*> &revs);
+    static QByteArray* loadRevs(const QString &gitDir, const QStringList &args, QStringList &tips);
+
+private:
+    struct Segment
+    {
+        quint32 dirsNum;
+        quint32 filesNum;
+        const uchar* names; // dirs then files
+        const uchar* namesEnd;
+        const uchar* index; // sorted (sha, record offset) pairs
+        int count;
+        const uchar* records;
+        const uchar* end;
+    };
+    bool map();
+    void unmap();
+    void sync();
+    bool scan(StrVect* dirs, StrVect* files);
+    const uchar* findRecord(const ShaString &sha, const uchar** end = NULL) const;
+    static qint64 parseSegments(const uchar* data, qint64 size, QVector<Segment>& segs);
+    static bool write(const QString &path, qint64 ofs, const QByteArray &seg, bool compact);
+    static bool compact(const QString &path);
+
+    QFile file;
+    QByteArray fileData; // in case mapping is not available
+    const uchar* data;
+    qint64 dataSize;
+    qint64 validSize; // up to last complete segment
+    int dirsCnt;      // names already in file
+    int filesCnt;
+    QVector<Segment> segments;
+    QFuture<bool> saving;
+    bool mapPending;  // file is mapped again after saving
 };
 
 #endif
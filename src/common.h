@@ -12,6 +12,7 @@
 #include <QFont>
 #include <QHash>
 #include <QLatin1String>
+#include <QStringList>
 #include <QVariant>
 #include <QVector>
 #include "model/shastring.h"
@@ -47,7 +48,6 @@ inline const QString  _valueOf(size_t x) { return QString::number((uint)x); }
 
 #define FOREACH_SL(i, c)    FOREACH(QStringList, i, c)
 
-class QDataStream;
 class QProcess;
 class QSplitter;
 class QWidget;
@@ -60,8 +60,6 @@ typedef QVector<QString>            StrVect;
 typedef QVector<ShaString>          ShaVect;
 typedef QSet<QString>               ShaSet;
 
-uint qHash(const ShaString&); // optimized custom hash for sha strings
-
 namespace QGit
 {
     // minimum git version required
@@ -138,12 +136,9 @@ namespace QGit
     extern const QString PATCHES_NAME;
 
     // git index parameters
-    extern const QByteArray ZERO_SHA_BA;
     extern const ShaString  ZERO_SHA_RAW;
 
     extern const QString ZERO_SHA;
-    extern const QString CUSTOM_SHA;
-    extern const QString ALL_MERGE_FILES;
 
     // settings keys
     extern const QString ORG_KEY;
@@ -203,10 +198,6 @@ namespace QGit
 
     const int FLAGS_DEF = USE_CMT_MSG_F | RANGE_SELECT_F | SMART_LBL_F | VERIFY_CMT_F | SIGN_PATCH_F | LOG_DIFF_TAB_F | MSG_ON_NEW_F;
 
-    // ShaString helpers
-    const ShaString toTempSha(const QString&); // use as argument only, see definition
-    const ShaString toPersistentSha(const QString&, QVector<QByteArray>&);
-
     // settings helpers
     uint flags(SCRef flagsVariable);
     bool testFlag(uint f, SCRef fv = FLAGS_KEY);
@@ -229,17 +220,26 @@ namespace QGit
     bool readFromFile(SCRef fileName, QString& data);
     bool startProcess(QProcess* proc, SCList args, SCRef buf = "", bool* winShell = NULL);
 
-    // cache file
+    // cache files
     const uint C_MAGIC  = 0xA0B0C0D0;
-    const int C_VERSION = 15;
+    const int C_VERSION = 17;
+    const int MAX_CACHE_SEGMENTS = 8; // file names cache is compacted above this
+    const uint R_MAGIC  = 0xA0B0C0D1;
+    const int R_VERSION = 2;
+    const int R_BLOCK_SIZE = 1024 * 1024; // revisions cache is packed in blocks of this size
 
     extern const QString BAK_EXT;
     extern const QString C_DAT_FILE;
+    extern const QString R_DAT_FILE;
 
     // misc
     const int MAX_DICT_SIZE    = 100003; // must be a prime number see QDict docs
     const int MAX_MENU_ENTRIES = 20;
     const int MAX_RECENT_REPOS = 7;
+    const int LANES_CHECKPOINT_STEP = 512; // max rows to walk when jumping in graph
+    const int MAX_DIFF_TREE_PROCS   = 4;    // max parallel 'git diff-tree' loading file names
+    const int MIN_DIFF_TREE_SHARD   = 2000; // min revisions for each one of them
+    const int LOG_INDEX_BLOCK_SHIFT = 4;    // log messages are indexed in blocks of 16 revisions
     extern const QString QUOTE_CHAR;
     extern const QString SCRIPT_EXT;
 }
@@ -248,6 +248,7 @@ class RevFile
 {
     friend class Cache; // to directly load status
     friend class Git;
+    friend class DiffTreeLoader;
 
     // Status information is splitted in a flags vector and in a string
     // vector in 'status' are stored flags according to the info returned
@@ -287,7 +288,7 @@ public:
      * name, first all the dirs are listed then the file names to
      * achieve a better compression when saved to disk.
      * A single QByteArray is used instead of two vectors because it's
-     * much faster to load from disk when using a QDataStream
+     * stored as is in file names cache, see Cache
      */
     QByteArray pathsIdx;
 
@@ -316,11 +317,9 @@ public:
     */
         return (!extStatus.isEmpty() && idx < extStatus.count() ? extStatus.at(idx) : "");
     }
-
-    const RevFile& operator>>(QDataStream&) const;
-    RevFile& operator<<(QDataStream&);
 };
 typedef QHash<ShaString, const RevFile*> RevFileMap;
+typedef QVector<QByteArray> PathsVect; // raw paths, see Git::parseDiffFormatLine()
 
 
 class FileAnnotation
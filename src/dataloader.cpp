@@ -8,26 +8,82 @@
 */
 #include <QDir>
 #include <QTemporaryFile>
+#include <QtConcurrentMap>
 #include "git.h"
 #include "dataloader.h"
+#include "model/bytescan.h"
 
-#define GUI_UPDATE_INTERVAL 500
-#define READ_BLOCK_SIZE     65535
+#define GUI_UPDATE_INTERVAL  500
+#define READ_BLOCK_SIZE      65535
+#define MIN_PARALLEL_RECORDS 32
 
 class UnbufferedTemporaryFile : public QTemporaryFile
 {
 public:
     explicit UnbufferedTemporaryFile(QObject* p) : QTemporaryFile(p) {}
-    bool unbufOpen() { return open(QIODevice::ReadOnly | QIODevice::Unbuffered); }
+    // read-write because Revision '\0' fixups are done in place when mapped
+    bool unbufOpen() { return open(QIODevice::ReadWrite | QIODevice::Unbuffered); }
 };
 
+struct RevRecord // a complete 'git log' record, indexed by a worker thread
+{
+    const QByteArray* ba;
+    const ByteMarks* bm; // line index of the whole block
+    int start;
+    int end; // one past the terminating '\0'
+    void* mem; // arena is not thread safe, so allocated in advance
+    Revision* rev;
+};
+
+static void indexRecord(RevRecord& rr) {
+
+    int next;
+    // full indexing here, not later in GUI thread
+    rr.rev = new (rr.mem) Revision(*rr.ba, rr.start, 0, &next, false, rr.bm);
+    if (next != rr.end) { // record boundary was wrong, let serial path handle it
+        rr.rev->~Revision();
+        rr.rev = NULL;
+    }
+}
+
+static int recordEnd(const char* data, int start, int size, const ByteMarks& bm) {
+/*
+   Returns the offset after the terminating '\0' of the record starting
+   at 'start', or -1 if the record is not complete. Only records starting
+   with 'log size' or with the boundary info are recognized, anything else,
+   as example "Final output" lines, is left to Git::addChunk()
+*/
+    if (size - start > 9 && !qstrncmp(data + start, "log size ", 9)) {
+
+        int logSize = 0, idx = start + 9, eol = bm.next('\n', idx);
+        if (eol == -1)
+            return -1;
+
+        while (idx < eol)
+            logSize = logSize * 10 + data[idx++] - 48;
+
+        int revEnd = idx + 1 + logSize; // same as logEnd in Revision::indexData()
+        return (revEnd < size && logSize && data[revEnd] == '\0' ? revEnd + 1 : -1);
+    }
+    if (start >= size || (data[start] != '>' && data[start] != '<' && data[start] != '-'))
+        return -1;
+
+    // no log size, search for "\n\0" as Revision::indexData() does
+    for (int p = bm.next('\0', start + 1); p != -1; p = bm.next('\0', p + 1))
+        if (data[p - 1] == '\n')
+            return p + 1;
+
+    return -1;
+}
+
 DataLoader::DataLoader(Git* g, FileHistory* f) : QProcess(g), git(g), fh(f)
 {
     canceling = parsing = false;
     isProcExited = true;
-    halfChunk = NULL;
+    halfChunk = cachedRecords = NULL;
     dataFile = NULL;
-    loadedBytes = 0;
+    loadedBytes = mapOfs = 0;
+    useMmap = true;
     guiUpdateTimer.setSingleShot(true);
 
     connect(git, SIGNAL(cancelAllProcesses()), this, SLOT(on_cancel()));
@@ -39,6 +95,7 @@ DataLoader::~DataLoader()
     // avoid a Qt warning in case we are
     // destroyed while still running
     waitForFinished(1000);
+    delete cachedRecords; // not consumed if canceled
 }
 
 void DataLoader::on_cancel(const FileHistory* f)
@@ -101,6 +158,9 @@ void DataLoader::on_timeout()
     // process could exit while we are processing so save the flag now
     bool lastBuffer = isProcExited;
     loadedBytes += readNewData(lastBuffer);
+    if (lastBuffer && cachedRecords)
+        loadedBytes += parseCachedRecords();
+
     emit newDataReady(fh); // inserting in list view is about 3% of total time
 
     if (lastBuffer) {
@@ -121,7 +181,7 @@ void DataLoader::parseSingleBuffer(const QByteArray& ba)
     if (ba.size() == 0 || canceling)
         return;
 
-    int ofs = 0, newOfs, bz = ba.size();
+    int ofs = 0, bz = ba.size();
 
     /* Due to unknown reasons randomly first byte
      * of 'ba' is 0, this seems to happen only when
@@ -136,11 +196,8 @@ void DataLoader::parseSingleBuffer(const QByteArray& ba)
 
         if (!halfChunk) {
 
-            newOfs = git->addChunk(fh, ba, ofs);
-            if (newOfs == -1)
-                break; // half chunk detected
-
-            ofs = newOfs;
+            ofs = parseRecords(ba, ofs);
+            break; // anything left is a half chunk
 
         } else { // less then 1% of cases with READ_BLOCK_SIZE = 64KB
 
@@ -160,6 +217,92 @@ void DataLoader::parseSingleBuffer(const QByteArray& ba)
         baAppend(&halfChunk, ba.constData() + ofs,  bz - ofs);
 }
 
+ulong DataLoader::parseCachedRecords()
+{
+/*
+   Cached records come from a previous session and are parsed after the
+   ones produced by 'git log', that is called only for the revisions not
+   reachable from the cached tips. So new revisions are never ancestors
+   of the cached ones and the whole sequence is still in topological order.
+*/
+    QByteArray* ba = cachedRecords;
+    cachedRecords = NULL;
+    fh->rowData.append(ba);
+
+    int ofs = parseRecords(*ba, 0);
+    if (ofs != ba->size() && !canceling)
+        dbs("ASSERT in DataLoader: unparsed data in revisions cache");
+
+    return ofs;
+}
+
+int DataLoader::parseRecords(const QByteArray& ba, int ofs)
+{
+// parses all the complete records from 'ofs' on and returns
+// the offset of the first not complete one, if any
+
+    int newOfs, bz = ba.size();
+    while (bz - ofs > 0 && !canceling) {
+
+        // index all the complete records at once with worker
+        // threads, then fall back on one-by-one parsing
+        ofs = indexRecords(ba, ofs);
+        if (bz - ofs <= 0)
+            break;
+
+        newOfs = git->addChunk(fh, ba, ofs);
+        if (newOfs == -1)
+            break; // half chunk detected
+
+        ofs = newOfs;
+    }
+    return ofs;
+}
+
+int DataLoader::indexRecords(const QByteArray& ba, int ofs)
+{
+    if (!git->isMainHistory(fh)) // file history records carry diffs, keep it simple
+        return ofs;
+
+    const char* data = ba.constData();
+    int bz = ba.size(), start = ofs, end;
+    QVector<RevRecord> recs;
+
+    // one pass on the block, then records are split and
+    // indexed looking up the line index, not the data
+    ByteMarks bm;
+    bm.scan(data, ofs, bz);
+
+    while ((end = recordEnd(data, start, bz, bm)) != -1) {
+        RevRecord rr = { &ba, &bm, start, end, NULL, NULL };
+        recs.append(rr);
+        start = end;
+    }
+    if (recs.count() < MIN_PARALLEL_RECORDS)
+        return ofs; // not worth the threads overhead
+
+    for (int i = 0; i < recs.count(); i++)
+        recs[i].mem = fh->arena.alloc(sizeof(Revision));
+
+    QtConcurrent::blockingMap(recs, indexRecord);
+
+    // ordered insertion must be done in GUI thread, records
+    // after a bad one will be parsed again by the caller
+    int i = 0;
+    for ( ; i < recs.count() && recs.at(i).rev; i++) {
+        git->addRevision(fh, recs.at(i).rev);
+        ofs = recs.at(i).end;
+    }
+    // give back memory of the dropped ones, last allocated first
+    for (int j = recs.count() - 1; j >= i; j--) {
+        if (recs.at(j).rev)
+            recs.at(j).rev->~Revision();
+
+        fh->arena.release(recs.at(j).mem, sizeof(Revision));
+    }
+    return ofs;
+}
+
 void DataLoader::addSplittedChunks(const QByteArray* hc)
 {
     if (hc->at(hc->size() - 1) != 0) {
@@ -236,6 +379,9 @@ ulong DataLoader::readNewData(bool lastBuffer)
     if (!ok)
         return 0;
 
+    if (useMmap)
+        return mapNewData(lastBuffer);
+
     ulong cnt = 0;
     qint64 readPos = dataFile->pos();
 
@@ -276,6 +422,54 @@ ulong DataLoader::readNewData(bool lastBuffer)
     return cnt;
 }
 
+ulong DataLoader::mapNewData(bool lastBuffer)
+{
+/*
+   Instead of reading the file in fresh allocated blocks, map it from the
+   first not yet parsed record up to the current end, revisions then index
+   directly into the mapping. Only complete records are parsed, the trailing
+   one is mapped again, together with new data, at next call. So a record
+   never straddles two buffers and no copy at all is done, the mapping is
+   shared with the (tmpfs) file pages, also Revision '\0' fixups are written
+   in place. Mapped file is handed over to fh that keeps it alive until
+   rowData is cleared.
+*/
+    if (lastBuffer) { // be sure stream is null terminated
+        dataFile->seek(dataFile->size());
+        dataFile->write("", 1);
+    }
+    qint64 len = dataFile->size() - mapOfs;
+    if (len <= 0)
+        return 0;
+
+    uchar* mem = dataFile->map(mapOfs, len);
+    if (!mem) {
+        dbs("WARNING: unable to map temporary file, fallback on read()");
+        useMmap = false;
+        dataFile->seek(mapOfs); // a record boundary, no half chunk
+        return readNewData(lastBuffer);
+    }
+    QByteArray* ba = new QByteArray(QByteArray::fromRawData((const char*)mem, len));
+
+    int ofs = 0;
+    while (ofs < len && ba->at(ofs) == 0) // see parseSingleBuffer()
+        ofs++;
+
+    ofs = parseRecords(*ba, ofs);
+    if (ofs == 0) { // wait for a whole record
+        delete ba;
+        dataFile->unmap(mem);
+        return 0;
+    }
+    if (dataFile->parent() != fh) {
+        dataFile->setParent(fh);
+        fh->rowDataFiles.append(dataFile);
+    }
+    fh->rowData.append(ba);
+    mapOfs += ofs;
+    return ofs;
+}
+
 bool DataLoader::createTemporaryFile()
 {
     // redirect 'git log' output to a temporary file
@@ -17,7 +17,8 @@ class QString;
 class UnbufferedTemporaryFile;
 
 // data exchange facility with 'git log' could be based on QProcess or on
-// a temporary file (default). Uncomment following line to use QProcess
+// a temporary file (default), memory mapped when possible. Uncomment
+// following line to use QProcess
 // #define USE_QPROCESS
 
 class DataLoader : public QProcess
@@ -27,6 +28,7 @@ public:
     DataLoader(Git *g, FileHistory *f);
     ~DataLoader();
     bool start(const QStringList &args, const QString &wd, const QString &buf);
+    void appendCachedRecords(QByteArray *ba) { cachedRecords = ba; } // takes ownership
 
 signals:
     void newDataReady(const FileHistory*);
@@ -40,18 +42,25 @@ private slots:
 
 private:
     void parseSingleBuffer(const QByteArray &ba);
+    int parseRecords(const QByteArray &ba, int ofs);
+    int indexRecords(const QByteArray &ba, int ofs);
     void baAppend(QByteArray **src, const char *ascii, int len);
     void addSplittedChunks(const QByteArray *halfChunk);
     bool createTemporaryFile();
     ulong readNewData(bool lastBuffer);
+    ulong mapNewData(bool lastBuffer);
+    ulong parseCachedRecords();
 
     Git *git;
     FileHistory *fh;
     QByteArray *halfChunk;
+    QByteArray *cachedRecords;
     UnbufferedTemporaryFile *dataFile;
     QTime loadTime;
     QTimer guiUpdateTimer;
     ulong loadedBytes;
+    qint64 mapOfs;
+    bool useMmap;
     bool isProcExited;
     bool parsing;
     bool canceling;
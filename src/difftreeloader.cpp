@@ -0,0 +1,141 @@
+/*
+    Description: parallel loader of revisions file names
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#include <string.h> // used by memchr()
+#include <QtConcurrentRun>
+#include "git.h"
+#include "difftreeloader.h"
+
+static void freeBatch(DiffTreeBatch& b) {
+
+    for (int i = 0; i < b.revs.count(); i++)
+        delete b.revs.at(i).rf;
+
+    b.revs.clear();
+}
+
+DiffTreeLoader::DiffTreeLoader(Git* g) : QObject(g), git(g) {
+
+    isProcExited = parsing = canceling = false;
+
+    connect(git, SIGNAL(cancelAllProcesses()), this, SLOT(on_cancel()));
+    connect(&watcher, SIGNAL(finished()), this, SLOT(on_parsed()));
+}
+
+bool DiffTreeLoader::start(SCRef shaList) {
+
+    return (git->runAsync("git diff-tree --no-color -r -C --stdin", this, shaList) != NULL);
+}
+
+void DiffTreeLoader::on_cancel() {
+
+    canceling = true;
+    if (parsing) { // worker has nothing to cancel, it's just a batch
+        watcher.waitForFinished();
+        DiffTreeBatch b(watcher.result());
+        freeBatch(b);
+        parsing = false;
+    }
+    deleteLater();
+}
+
+void DiffTreeLoader::procReadyRead(const QByteArray& chunk) {
+
+    if (canceling)
+        return;
+
+    pending.append(chunk);
+
+    // cut before the header of the last revision, all
+    // the revisions before it are surely complete
+    int pos = pending.size();
+    while (pos > 0 && (pos = pending.lastIndexOf('\n', pos - 1)) != -1)
+        if (pos + 1 < pending.size() && pending.at(pos + 1) != ':')
+            break;
+
+    if (pos > 0) {
+        ready.append(pending.constData(), pos + 1);
+        pending.remove(0, pos + 1);
+    }
+    if (!parsing && !ready.isEmpty())
+        startParse();
+}
+
+void DiffTreeLoader::procFinished() {
+
+    if (canceling)
+        return;
+
+    isProcExited = true;
+    ready.append(pending);
+    pending.clear();
+
+    if (parsing)
+        return; // on_parsed() will take care of the rest
+
+    if (!ready.isEmpty())
+        startParse();
+    else {
+        emit loaded();
+        deleteLater();
+    }
+}
+
+void DiffTreeLoader::startParse() {
+
+    parsing = true;
+    watcher.setFuture(QtConcurrent::run(&DiffTreeLoader::parse, ready));
+    ready.clear(); // worker keeps its shallow copy
+}
+
+void DiffTreeLoader::on_parsed() {
+
+    if (canceling) // batch already freed
+        return;
+
+    parsing = false;
+    DiffTreeBatch b(watcher.result());
+    git->mergeFileNames(b);
+
+    // data arrived in the meantime has been accumulated
+    // in 'ready' and it's parsed now as a single batch
+    if (!ready.isEmpty())
+        startParse();
+
+    else if (isProcExited) {
+        emit loaded();
+        deleteLater();
+    }
+}
+
+DiffTreeBatch DiffTreeLoader::parse(const QByteArray& ba) {
+// called in a worker thread, here we cannot touch Git
+
+    DiffTreeBatch batch;
+    batch.data = ba; // keeps paths raw data alive
+    const char* data = ba.constData();
+    const int size = ba.size();
+    int start = 0;
+
+    while (start < size) {
+
+        const char* eol = (const char*)memchr(data + start, '\n', size - start);
+        int end = (eol ? eol - data : size);
+        int len = end - start;
+
+        if (len >= 40 && data[start] != ':') { // new revision
+            batch.revs.append(DiffTreeRev());
+            batch.revs.last().sha = ShaString(data + start);
+            batch.revs.last().rf = new RevFile();
+
+        } else if (len > 0 && data[start] == ':' && !batch.revs.isEmpty()) {
+            DiffTreeRev& r = batch.revs.last();
+            Git::parseDiffFormatLine(*r.rf, data + start, len, 1, r.paths);
+        }
+        start = end + 1;
+    }
+    return batch;
+}
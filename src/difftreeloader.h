@@ -0,0 +1,62 @@
+#ifndef DIFFTREELOADER_H
+#define DIFFTREELOADER_H
+
+#include <QFutureWatcher>
+#include <QVector>
+#include "common.h"
+#include "model/shastring.h"
+
+class Git;
+
+struct DiffTreeRev // a revision file list parsed by a worker thread
+{
+    DiffTreeRev() : rf(NULL) {}
+
+    ShaString sha;
+    RevFile* rf;     // pathsIdx still empty
+    PathsVect paths; // to be indexed in GUI thread, see Git::mergeFileNames()
+};
+
+struct DiffTreeBatch
+{
+    QByteArray data; // parsed output, paths point into it
+    QVector<DiffTreeRev> revs;
+};
+
+/*
+   Reads the output of one 'git diff-tree --stdin' process. Complete
+   revisions are parsed in batches by a worker thread while the process
+   keeps running, then merged in Git::revsFiles in GUI thread. Only one
+   batch per loader is in flight, so the number of busy threads is
+   bounded by the number of loaders.
+*/
+class DiffTreeLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DiffTreeLoader(Git* g);
+    bool start(SCRef shaList);
+
+signals:
+    void loaded();
+
+private slots:
+    void procReadyRead(const QByteArray&);
+    void procFinished();
+    void on_cancel();
+    void on_parsed();
+
+private:
+    void startParse();
+    static DiffTreeBatch parse(const QByteArray& ba);
+
+    Git* git;
+    QByteArray pending; // last revision, could be not complete
+    QByteArray ready;   // complete revisions waiting for a worker
+    QFutureWatcher<DiffTreeBatch> watcher;
+    bool isProcExited;
+    bool parsing;
+    bool canceling;
+};
+
+#endif
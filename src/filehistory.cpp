@@ -37,7 +37,7 @@ FileHistory::FileHistory(QObject* p, Git* g) : QAbstractItemModel(p), git(g)
 
 FileHistory::~FileHistory()
 {
-    clear();
+    clear(); // also waits for lanes precomputing
     delete lns;
 }
 
@@ -75,12 +75,12 @@ void FileHistory::flushTail()
         dbp("ASSERT in FileHistory::flushTail(), earlyOutputCnt is %1", earlyOutputCnt);
         return;
     }
+    stopLanesPrecompute();
+    lanesCheckpoints.clear();
+
     int cnt = revOrder.count() - earlyOutputCnt + 1;
     while (cnt > 0) {
-        const ShaString& sha = revOrder.last();
-        const Revision* c = revs[sha];
-        delete c;
-        revs.remove(sha);
+        revs.remove(revOrder.last()); // rev memory is reclaimed with the arena
         revOrder.pop_back();
         cnt--;
     }
@@ -95,6 +95,36 @@ void FileHistory::flushTail()
     reset();
 }
 
+void FileHistory::addLanesCheckpoint(int row, const Lanes& l)
+{
+    // checkpoints are appended in row order, by GUI thread
+    // or by Git::precomputeLanes() in a worker thread
+    QMutexLocker lock(&lanesMutex);
+    if (row == lanesCheckpoints.count() * LANES_CHECKPOINT_STEP)
+        lanesCheckpoints.append(l);
+}
+
+int FileHistory::lanesCheckpoint(int row, Lanes* l)
+{
+    // returns the row of the nearest checkpoint up to 'row'
+    // and its lanes state, or -1 if there is none
+    QMutexLocker lock(&lanesMutex);
+    int idx = qMin(row / LANES_CHECKPOINT_STEP, lanesCheckpoints.count() - 1);
+    if (idx < 0)
+        return -1;
+
+    *l = lanesCheckpoints.at(idx);
+    return idx * LANES_CHECKPOINT_STEP;
+}
+
+void FileHistory::stopLanesPrecompute()
+{
+    // must be called before changing revOrder
+    lanesCanceled = 1;
+    lanesPrecompute.waitForFinished();
+    lanesCanceled = 0;
+}
+
 void FileHistory::clear(bool complete)
 {
     if (!complete) {
@@ -103,17 +133,22 @@ void FileHistory::clear(bool complete)
         return;
     }
     git->cancelDataLoading(this);
+    stopLanesPrecompute();
 
-    qDeleteAll(revs);
     revs.clear();
+    mergeRevs.clear();
+    arena.clear(); // frees all the revisions at once
     revOrder.clear();
     firstFreeLane = loadTime = earlyOutputCntBase = 0;
     setEarlyOutputState(false);
     lns->clear();
+    lanesCheckpoints.clear();
     fNames.clear();
     curFNames.clear();
     qDeleteAll(rowData);
     rowData.clear();
+    qDeleteAll(rowDataFiles); // unmaps and removes the files
+    rowDataFiles.clear();
 
     if (testFlag(REL_DATE_F)) {
         secs = QDateTime::currentDateTime().toTime_t();
@@ -2,11 +2,14 @@
 #define FILEHISTORY_H
 
 #include <QAbstractItemModel>
+#include <QFuture>
+#include <QMutex>
 #include "common.h"
 #include "git.h"
 #include "lanes.h"
 #include "exceptionmanager.h"
 
+class QFile;
 class Cache;
 class DataLoader;
 class Domain;
@@ -50,14 +53,24 @@ private:
     friend class Git;
 
     void flushTail();
+    void addLanesCheckpoint(int row, const Lanes& l);
+    int lanesCheckpoint(int row, Lanes* l);
+    void stopLanesPrecompute();
     const QString timeDiff(unsigned long secs) const;
 
     Git* git;
+    RevArena arena; // revisions and their vectors storage
     RevMap revs;
+    MergeRevMap mergeRevs; // other parents patches of merges split by 'git log -m'
     ShaVect revOrder;
     Lanes* lns;
     uint firstFreeLane;
+    QVector<Lanes> lanesCheckpoints; // lanes state every LANES_CHECKPOINT_STEP rows
+    QMutex lanesMutex;
+    QFuture<void> lanesPrecompute;
+    QAtomicInt lanesCanceled;
     QList<QByteArray*> rowData;
+    QList<QFile*> rowDataFiles; // files backing memory mapped rowData
     QList<QVariant> headerInfo;
     int rowCnt;
     bool annIdValid;
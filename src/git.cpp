@@ -6,7 +6,9 @@
     Copyright: See COPYING file that comes with this distribution
 
 */
+#include <string.h> // used by memchr()
 #include <QApplication>
+#include <QBitArray>
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
@@ -18,11 +20,14 @@
 #include <QTextCodec>
 #include <QTextDocument>
 #include <QTextStream>
+#include <QThread>
+#include <QtConcurrentRun>
 #include "annotate.h"
 #include "cache.h"
 #include "git.h"
 #include "lanes.h"
 #include "myprocess.h"
+#include "patchsearch.h"
 
 #include <QPair>
 #include <QSettings>
@@ -32,6 +37,8 @@
 #include "mainimpl.h"
 #include "dataloader.h"
 
+static const char* TREE_INDEX_PENDING = "computing...";
+
 
 using namespace QGit;
 
@@ -53,16 +60,22 @@ bool Git::TreeEntry::operator<(const TreeEntry& te) const
     return (this->name < te.name);
 }
 
-Git::Git(QObject* p) : QObject(p)
+Git::Git(QObject* p) : QObject(p), pathTrie(dirNamesVec, fileNamesVec), bodiesIndex(LOG_INDEX_BLOCK_SHIFT)
 {
     EM_INIT(exGitStopped, "Stopping connection with git");
 
     fileCacheAccessed = cacheNeedsUpdate = isMergeHead = false;
+    filesLoadingStartOfs = filesLoadingActive = 0;
     isStGIT = isGIT = loadingUnAppliedPatches = isTextHighlighterFound = false;
     errorReportingEnabled = true; // report errors if run() fails
     curDomain = NULL;
     revData = NULL;
+    customFiles = NULL;
+    fileCache = new Cache(this);
+    treeIndex = NULL;
     revsFiles.reserve(MAX_DICT_SIZE);
+
+    connect(&treeIndexWatcher, SIGNAL(finished()), this, SLOT(on_treeIndexReady()));
 }
 
 void Git::checkEnvironment()
@@ -354,7 +367,7 @@ const QString Git::getRevInfo(SCRef sha)
 // TODO: move to reference property
 const QString Git::getTagMsg(SCRef sha)
 {
-    ShaString shaString = toTempSha(sha);
+    const ShaString shaString(sha);
     if (!shaMap.checkRef(shaString, Reference::TAG)) {
         dbs("ASSERT in Git::getTagMsg, tag not found");
         return "";
@@ -455,13 +468,13 @@ void Git::cancelDataLoading(const FileHistory* fh)
 
 const Revision* Git::revLookup(SCRef sha, const FileHistory* fh) const
 {
-    return revLookup(toTempSha(sha), fh);
+    return revLookup(ShaString(sha), fh);
 }
 
 const Revision* Git::revLookup(const ShaString& sha, const FileHistory* fh) const
 {
     const RevMap& r = (fh ? fh->revs : revData->revs);
-    return (sha.latin1() ? r.value(sha) : NULL);
+    return (!sha.isNull() ? r.value(sha) : NULL);
 }
 
 bool Git::run(SCRef runCmd, QString* runOutput, QObject* receiver, SCRef buf)
@@ -525,12 +538,16 @@ int Git::findFileIndex(const RevFile& rf, SCRef name)
     if (name.isEmpty())
         return -1;
 
-    int idx = name.lastIndexOf('/') + 1;
-    SCRef dr = name.left(idx);
-    SCRef nm = name.mid(idx);
+    // compare interned indices, not strings
+    const QByteArray ba(name.toAscii());
+    int idx = ba.lastIndexOf('/') + 1;
+    int dr = dirNamesMap.value(QByteArray::fromRawData(ba.constData(), idx), -1);
+    int nm = fileNamesMap.value(QByteArray::fromRawData(ba.constData() + idx, ba.size() - idx), -1);
+    if (dr == -1 || nm == -1)
+        return -1;
 
     for (uint i = 0, cnt = rf.count(); i < cnt; ++i) {
-        if (fileNamesVec[rf.nameAt(i)] == nm && dirNamesVec[rf.dirAt(i)] == dr)
+        if (rf.nameAt(i) == nm && rf.dirAt(i) == dr)
             return i;
     }
     return -1;
@@ -544,7 +561,7 @@ const QString Git::getLaneParent(SCRef fromSHA, int laneNum)
 
     for (int idx = rs->orderIdx - 1; idx >= 0; idx--) {
 
-        const Revision* r = revLookup(revData->revOrder[idx]);
+        const Revision* r = revLookup(revData->revOrder.at(idx));
         if (laneNum >= r->lanes.count())
             return "";
 
@@ -569,11 +586,12 @@ const QStringList Git::getChilds(SCRef parent)
 {
     QStringList childs;
     const Revision* r = revLookup(parent);
-    if (!r)
+    if (!r || !treeIndex)
         return childs;
 
-    for (int i = 0; i < r->childs.count(); i++)
-        childs.append(revData->revOrder[r->childs[i]]);
+    const ArenaVector<int>& c = treeIndex->childs(r->orderIdx);
+    for (int i = 0; i < c.count(); i++)
+        childs.append(revData->revOrder.at(c[i]));
 
     // reorder childs by loading order
     QStringList::iterator itC(childs.begin());
@@ -853,14 +871,20 @@ const QStringList Git::getDescendantBranches(SCRef sha, bool shaOnly)
 {
     QStringList tl;
     const Revision* r = revLookup(sha);
-    if (!r || (r->descBrnMaster == -1))
+    if (!r)
         return tl;
 
-    const QVector<int>& nr = revLookup(revData->revOrder[r->descBrnMaster])->descBranches;
+    if (!treeIndex && !shaOnly)
+        return QStringList(TREE_INDEX_PENDING);
+
+    // callers asking for shas need the real answer also while
+    // the index is being built, so walk the graph in that case
+    const QVector<int> nr = (treeIndex ? treeIndex->descBranches(r->orderIdx)
+                                       : walkDescendantBranches(r));
 
     for (int i = 0; i < nr.count(); i++) {
 
-        const ShaString& sha = revData->revOrder[nr[i]];
+        const ShaString& sha = revData->revOrder.at(nr[i]);
         if (shaOnly) {
             tl.append(sha);
             continue;
@@ -879,6 +903,79 @@ const QStringList Git::getDescendantBranches(SCRef sha, bool shaOnly)
     return tl;
 }
 
+const QVector<int> Git::walkDescendantBranches(const Revision* r)
+{
+/*
+   Same result of TreeIndex::descBranches() without the index. Parents
+   always come after their children in graph order, so walking up from
+   'r' to the top each revision knows if any of its parents reaches 'r'.
+*/
+    const ShaVect& ro = revData->revOrder;
+    QBitArray reach(r->orderIdx + 1);
+    reach.setBit(r->orderIdx);
+    QVector<int> nr;
+    for (int i = r->orderIdx; i >= 0; i--) {
+
+        const Revision* c = revLookup(ro.at(i));
+        for (uint y = 0; c && !reach.testBit(i) && y < c->parentsCount(); y++) {
+
+            const Revision* p = revLookup(c->parent(y));
+            reach.setBit(i, p && p->orderIdx <= r->orderIdx && reach.testBit(p->orderIdx));
+        }
+        if (reach.testBit(i) && shaMap.checkRef(ro.at(i), Reference::BRANCH | Reference::REMOTE_BRANCH))
+            nr.prepend(i);
+    }
+    return nr;
+}
+
+bool Git::isAncestor(SCRef ancestor, SCRef sha)
+{
+    // 'git merge-base' prints a full sha, so an abbreviated
+    // one or a ref name must be resolved before comparing
+    const QString ancSha(revLookup(ancestor) ? ancestor : getRefSha(ancestor));
+    if (ancSha.isEmpty())
+        return false;
+
+    bool isAnc;
+    if (ancestryFromIndex(ancSha, sha, &isAnc))
+        return isAnc;
+
+    // not loaded or index still computing, ask git
+    return (mergeBase(ancSha, sha) == ancSha);
+}
+
+bool Git::ancestryFromIndex(SCRef ancestor, SCRef sha, bool* isAnc)
+{
+    // never runs git, returns false if both revisions
+    // are not in main view or the index is not ready
+    const Revision* a = revLookup(ancestor);
+    const Revision* r = revLookup(sha);
+    if (!a || !r || !treeIndex)
+        return false;
+
+    *isAnc = treeIndex->isAncestor(a->orderIdx, r->orderIdx);
+    return true;
+}
+
+const QString Git::mergeBase(SCRef sha1, SCRef sha2)
+{
+    const Revision* r1 = revLookup(sha1);
+    const Revision* r2 = revLookup(sha2);
+    if (r1 && r2 && treeIndex) {
+        int idx = treeIndex->mergeBase(r1->orderIdx, r2->orderIdx);
+        return (idx != -1 ? QString(revData->revOrder.at(idx)) : "");
+    }
+    // no common ancestor is not an error
+    QString runOutput;
+    errorReportingEnabled = false;
+    bool ok = run("git merge-base " + sha1 + " " + sha2, &runOutput);
+    errorReportingEnabled = true;
+    if (!ok)
+        return "";
+
+    return runOutput.trimmed();
+}
+
 const QStringList Git::getNearTags(bool goDown, SCRef sha)
 {
     QStringList tl;
@@ -886,16 +983,14 @@ const QStringList Git::getNearTags(bool goDown, SCRef sha)
     if (!r)
         return tl;
 
-    int nearRefsMaster = (goDown ? r->descRefsMaster : r->ancRefsMaster);
-    if (nearRefsMaster == -1)
-        return tl;
+    if (!treeIndex)
+        return QStringList(TREE_INDEX_PENDING);
 
-    const QVector<int>& nr = goDown ? revLookup(revData->revOrder[nearRefsMaster])->descRefs :
-                                      revLookup(revData->revOrder[nearRefsMaster])->ancRefs;
+    const QVector<int> nr = treeIndex->nearTags(goDown, r->orderIdx);
 
     for (int i = 0; i < nr.count(); i++) {
 
-        const ShaString& sha = revData->revOrder[nr[i]];
+        const ShaString& sha = revData->revOrder.at(nr[i]);
         SCRef cap = " (" + sha + ")";
         ShaMap::const_iterator it(shaMap.find(sha));
         if (it != shaMap.constEnd())
@@ -1065,7 +1160,7 @@ const QString Git::getDesc(SCRef sha, QRegExp& shortLogRE, QRegExp& longLogRE, b
     return text;
 }
 
-const RevFile* Git::insertNewFiles(SCRef sha, SCRef data)
+RevFile* Git::parseNewFiles(const QByteArray& data)
 {
     /* we use an independent FileNamesLoader to avoid data
      * corruption if we are loading file names in background
@@ -1075,12 +1170,10 @@ const RevFile* Git::insertNewFiles(SCRef sha, SCRef data)
     RevFile* rf = new RevFile();
     parseDiffFormat(*rf, data, fl);
     flushFileNames(fl);
-
-    revsFiles.insert(toPersistentSha(sha, revsFilesShaBackupBuf), rf);
     return rf;
 }
 
-bool Git::runDiffTreeWithRenameDetection(SCRef runCmd, QString* runOutput)
+bool Git::runDiffTreeWithRenameDetection(SCRef runCmd, QByteArray* runOutput)
 {
 /* Under some cases git could warn out:
 
@@ -1092,29 +1185,30 @@ bool Git::runDiffTreeWithRenameDetection(SCRef runCmd, QString* runOutput)
     cmd.replace("git diff-tree", "git diff-tree -C");
 
     errorReportingEnabled = false;
-    bool renameDetectionOk = run(cmd, runOutput);
+    bool renameDetectionOk = run(runOutput, cmd);
     errorReportingEnabled = true;
 
     if (!renameDetectionOk) // retry without rename detection
-        return run(runCmd, runOutput);
+        return run(runOutput, runCmd);
 
     return true;
 }
 
 const RevFile* Git::getAllMergeFiles(const Revision* r)
 {
-    SCRef mySha(ALL_MERGE_FILES + r->sha());
-    if (revsFiles.contains(toTempSha(mySha)))
-        return revsFiles[toTempSha(mySha)];
+    if (mergeFiles.contains(r->sha()))
+        return mergeFiles[r->sha()];
 
     EM_PROCESS_EVENTS; // 'git diff-tree' could be slow
 
     QString runCmd("git diff-tree --no-color -r -m " + r->sha());
-    QString runOutput;
+    QByteArray runOutput;
     if (!runDiffTreeWithRenameDetection(runCmd, &runOutput))
         return NULL;
 
-    return insertNewFiles(mySha, runOutput);
+    RevFile* rf = parseNewFiles(runOutput);
+    mergeFiles.insert(r->sha(), rf);
+    return rf;
 }
 
 const RevFile* Git::getFiles(SCRef sha, SCRef diffToSha, bool allFiles, SCRef path)
@@ -1138,16 +1232,19 @@ const RevFile* Git::getFiles(SCRef sha, SCRef diffToSha, bool allFiles, SCRef pa
 
         EM_PROCESS_EVENTS; // 'git diff-tree' could be slow
 
-        QString runOutput;
+        QByteArray runOutput;
         if (!runDiffTreeWithRenameDetection(runCmd, &runOutput))
             return NULL;
 
-        // we insert a dummy revision file object. It will be
-        // overwritten at each request but we don't care.
-        return insertNewFiles(CUSTOM_SHA, runOutput);
+        // we keep only one custom revision file object. It will
+        // be overwritten at each request but we don't care.
+        delete customFiles;
+        customFiles = parseNewFiles(runOutput);
+        return customFiles;
     }
-    if (revsFiles.contains(r->sha()))
-        return revsFiles[r->sha()]; // ZERO_SHA search arrives here
+    const RevFile* rf = revFile(r->sha()); // ZERO_SHA search arrives here
+    if (rf)
+        return rf;
 
     if (sha == ZERO_SHA) {
         dbs("ASSERT in Git::getFiles, ZERO_SHA not found");
@@ -1156,7 +1253,8 @@ const RevFile* Git::getFiles(SCRef sha, SCRef diffToSha, bool allFiles, SCRef pa
 
     EM_PROCESS_EVENTS; // 'git diff-tree' could be slow
 
-    QString runCmd("git diff-tree --no-color -r -c " + sha), runOutput;
+    QString runCmd("git diff-tree --no-color -r -c " + sha);
+    QByteArray runOutput;
     if (!runDiffTreeWithRenameDetection(runCmd, &runOutput))
         return NULL;
 
@@ -1164,7 +1262,10 @@ const RevFile* Git::getFiles(SCRef sha, SCRef diffToSha, bool allFiles, SCRef pa
         return revsFiles[r->sha()];
 
     cacheNeedsUpdate = true;
-    return insertNewFiles(sha, runOutput);
+    RevFile* newRf = parseNewFiles(runOutput);
+    revsFiles.insert(r->sha(), newRf);
+    indexRevFile(r->sha(), *newRf); // could be already marked as indexed
+    return newRf;
 }
 
 bool Git::startFileHistory(SCRef sha, SCRef startingFileName, FileHistory* fh)
@@ -1218,51 +1319,262 @@ const QString Git::getNewestFileName(SCList branches, SCRef fileName)
     return curFileName;
 }
 
-void Git::getFileFilter(SCRef path, ShaSet& shaSet) const
+void Git::getFileFilter(SCRef path, ShaSet& shaSet)
 {
+    // case insensitive, wildcard search
+    getFileFilter(QRegExp(path, Qt::CaseInsensitive, QRegExp::Wildcard), shaSet);
+}
+
+void Git::getFileFilter(const QRegExp& rx, ShaSet& shaSet)
+{
+/*
+   Revisions touching each path are listed in pathRevs, so the pattern
+   is matched once for each distinct path and then the lists of the
+   matching ones are joined. Revisions not yet indexed, as example the
+   ones still in file names cache, are indexed here the first time,
+   cached ones straight from mapped data, without decoding a RevFile.
+   Revisions with no files yet, as merges and initial ones, are marked
+   as indexed too, if their files are loaded later indexRevFile() adds
+   them.
+
+   A match of a wildcard ending with '/', as 'src/net/', ends always in
+   the directory part of a path, so a file matches if its directory does
+   and a directory if its parent does. In this case only the directories
+   are matched, walking the path trie, and not each file path.
+*/
     shaSet.clear();
-    QRegExp rx(path, Qt::CaseInsensitive, QRegExp::Wildcard);
-    FOREACH (ShaVect, it, revData->revOrder) {
+    const ShaVect& ro = revData->revOrder;
+    QByteArray pathsIdx;
+    for (int i = 0; i < ro.count(); i++) {
 
-        if (!revsFiles.contains(*it))
+        if (indexedRevs.contains(i) || ro.at(i) == ZERO_SHA_RAW)
             continue;
 
-        // case insensitive, wildcard search
-        const RevFile* rf = revsFiles[*it];
-        for (int i = 0; i < rf->count(); ++i)
-            if (filePath(*rf, i).contains(rx)) {
-                shaSet.insert(*it);
-                break;
-            }
+        RevFileMap::const_iterator it(revsFiles.constFind(ro.at(i)));
+        if (it != revsFiles.constEnd())
+            indexPaths(i, (*it)->pathsIdx);
+
+        else if (fileCache->paths(ro.at(i), pathsIdx))
+            indexPaths(i, pathsIdx);
+
+        indexedRevs.insert(i);
+    }
+
+    const bool dirsOnly = (   rx.patternSyntax() == QRegExp::Wildcard
+                           && rx.pattern().endsWith('/'));
+    QBitArray dirHits(dirsOnly ? pathTrie.count() : 0);
+    for (int node = 0; node < dirHits.size(); node++) {
+
+        // parents are added to the trie before their children
+        int p = pathTrie.parent(node);
+        if (   pathTrie.isDir(node)
+            && ((p != -1 && dirHits.testBit(p)) || pathTrie.path(node).contains(rx)))
+            dirHits.setBit(node);
     }
+    QBitArray hits(ro.count());
+    for (int node = 0; node < pathRevs.count(); node++) {
+
+        if (pathRevs.at(node).isEmpty())
+            continue;
+
+        int p = pathTrie.parent(node);
+        if (dirsOnly ? (p == -1 || !dirHits.testBit(p)) : !pathTrie.path(node).contains(rx))
+            continue;
+
+        const QVector<uint> v(pathRevs.at(node).toVector());
+        for (int i = 0; i < v.count() && int(v.at(i)) < ro.count(); i++) // sorted
+            hits.setBit(v.at(i));
+    }
+    // working dir files change at each refresh, they are not indexed
+    const RevFile* wf = (!ro.isEmpty() && ro.first() == ZERO_SHA_RAW ? revFile(ZERO_SHA_RAW) : NULL);
+    for (int i = 0; wf && i < wf->count(); ++i)
+        if (filePath(*wf, i).contains(rx)) {
+            hits.setBit(0);
+            break;
+        }
+
+    for (int i = 0; i < ro.count(); i++)
+        if (hits.testBit(i))
+            shaSet.insert(ro.at(i));
 }
 
-bool Git::getPatchFilter(SCRef exp, bool isRegExp, ShaSet& shaSet)
+int Git::getLogFilter(SCRef filter, int colNum, ShaSet& shaSet)
 {
+/*
+   Same match of ListViewProxy::isMatch(), but only on the revisions
+   that have all the filter trigrams. Each field is indexed the first
+   time it is searched, then just the new revisions. Returns the number
+   of rows checked, rows loaded later must be matched as usual, or 0
+   if the filter has no trigrams, in that case all rows must be checked.
+*/
+    TrigramIndex& ti = (colNum == AUTH_COL ? authorsIndex
+                                           : (colNum == LOG_COL ? subjectsIndex : bodiesIndex));
+    const ShaVect& ro = revData->revOrder;
+    for (int i = ti.count(); i < ro.count(); i++) {
+
+        const Revision* r = revLookup(ro.at(i));
+        if (!r)
+            ti.add(QByteArray());
+        else if (colNum == AUTH_COL)
+            ti.add(r->rawAuthor());
+        else
+            ti.add(colNum == LOG_COL ? r->rawShortLog() : r->rawLongLog());
+    }
+    QVector<int> revs;
+    if (!ti.candidates(filter, revs))
+        return 0;
+
+    // working dir revision is rebuilt at each refresh, always check it
+    if (!ro.isEmpty() && ro.first() == ZERO_SHA_RAW && (revs.isEmpty() || revs.first() != 0))
+        revs.prepend(0);
+
     shaSet.clear();
-    QString buf;
-    FOREACH (ShaVect, it, revData->revOrder)
-        if (*it != ZERO_SHA_RAW)
-            buf.append(*it).append('\n');
+    QRegExp rx(filter, Qt::CaseInsensitive, QRegExp::Wildcard);
+    for (int i = 0; i < revs.count(); i++) {
 
-    if (buf.isEmpty())
-        return true;
+        const Revision* r = revLookup(ro.at(revs.at(i)));
+        if (!r)
+            continue;
 
-    EM_PROCESS_EVENTS; // 'git diff-tree' could be slow
+        const QString target(colNum == AUTH_COL ? r->author()
+                                                : (colNum == LOG_COL ? r->shortLog() : r->longLog()));
+        if (target.contains(rx))
+            shaSet.insert(ro.at(revs.at(i)));
+    }
+    return ti.count();
+}
+
+void Git::clearLogIndex() {
+
+    subjectsIndex.clear();
+    authorsIndex.clear();
+    bodiesIndex.clear();
+}
+
+void Git::indexRevFile(const ShaString& sha, const RevFile& rf) {
+
+    // only main view revisions, once loading is finished orderIdx is final
+    const Revision* rev = revLookup(sha);
+    if (   rev
+        && sha != ZERO_SHA_RAW
+        && rev->orderIdx < revData->revOrder.count()
+        && revData->revOrder.at(rev->orderIdx) == sha) {
+
+        indexPaths(rev->orderIdx, rf.pathsIdx);
+        indexedRevs.insert(rev->orderIdx);
+    }
+}
+
+void Git::indexPaths(int orderIdx, const QByteArray& pathsIdx) {
 
-    QString runCmd("git diff-tree --no-color -r -s --stdin "), runOutput;
-    if (isRegExp)
-        runCmd.append("--pickaxe-regex ");
+    // same layout of RevFile::pathsIdx, all the dirs then all the names
+    const int* p = (const int*)pathsIdx.constData();
+    const int cnt = pathsIdx.size() / (2 * sizeof(int));
+    for (int i = 0; i < cnt; ++i) {
 
-    runCmd.append(quote("-S" + exp));
-    if (!run(runCmd, &runOutput, NULL, buf))
+        int node = pathTrie.fileNode(p[i], p[cnt + i]);
+        if (node >= pathRevs.count())
+            pathRevs.resize(pathTrie.count());
+
+        pathRevs[node].insert(orderIdx);
+    }
+}
+
+void Git::clearPathIndex() {
+
+    pathRevs.clear();
+    indexedRevs = RevBitmap();
+}
+
+void Git::getQueryFilter(RevQuery& q, ShaSet& shaSet)
+{
+/*
+   Just one pass on the revisions, each one is checked against the
+   query terms in cost order and dropped at the first failing one. Path
+   terms use the path index, looked up only when a revision gets there
+   for the first time. Patch term is not matched here, returned
+   revisions are the ones to search with startPatchFilter().
+*/
+    shaSet.clear();
+    QVector<ShaSet> pathHits(q.count());
+    QBitArray pathReady(q.count());
+    const ShaVect& ro = revData->revOrder;
+    for (int i = 0; i < ro.count(); i++) {
+
+        const Revision* r = revLookup(ro.at(i));
+        if (!r)
+            continue;
+
+        bool ok = true;
+        for (int j = 0; ok && j < q.count(); j++) {
+
+            const RevQuery::Term& t = q.term(j);
+            if (t.field != RevQuery::PATH) {
+                ok = q.isMatch(j, r);
+                continue;
+            }
+            if (!pathReady.testBit(j)) {
+                getFileFilter(t.rx, pathHits[j]);
+                pathReady.setBit(j);
+            }
+            ok = (pathHits.at(j).contains(ro.at(i)) != t.negated);
+        }
+        if (ok)
+            shaSet.insert(ro.at(i));
+    }
+}
+
+bool Git::startPatchFilter(SCRef exp, bool isRegExp, const ShaSet* limit)
+{
+/*
+   Revisions are split in contiguous ranges searched by parallel
+   'git diff-tree' processes, matching ones are signaled as soon as
+   they are found with patchFilterFound(), then patchFilterDone() is
+   emitted. If 'limit' is given only the revisions in it are searched.
+   Returns false if no search could be started.
+*/
+    stopPatchFilter();
+
+    QStringList shas;
+    FOREACH (ShaVect, it, revData->revOrder)
+        if (*it != ZERO_SHA_RAW && (!limit || limit->contains(*it)))
+            shas.append(*it);
+
+    if (shas.isEmpty())
         return false;
 
-    const QStringList sl(runOutput.split('\n', QString::SkipEmptyParts));
-    FOREACH_SL (it, sl)
-        shaSet.insert(*it);
+    int shards = qBound(1, QThread::idealThreadCount(), MAX_DIFF_TREE_PROCS);
+    shards = qMin(shards, 1 + shas.count() / MIN_DIFF_TREE_SHARD);
+    int shardSize = (shas.count() + shards - 1) / shards;
 
-    return true;
+    for (int i = 0; i < shas.count(); i += shardSize) {
+
+        const QString buf(QStringList(shas.mid(i, shardSize)).join("\n").append('\n'));
+        PatchSearch* ps = new PatchSearch(this); // auto-deleted when done
+        connect(ps, SIGNAL(found(const QStringList&)), this, SIGNAL(patchFilterFound(const QStringList&)));
+        connect(ps, SIGNAL(done()), this, SLOT(on_patchSearchDone()));
+        if (ps->start(exp, isRegExp, buf))
+            patchSearches.append(ps);
+        else
+            delete ps;
+    }
+    return !patchSearches.isEmpty();
+}
+
+void Git::stopPatchFilter()
+{
+    // no more signals from running searches
+    FOREACH (QList<PatchSearch*>, it, patchSearches)
+        (*it)->cancel();
+
+    patchSearches.clear();
+}
+
+void Git::on_patchSearchDone()
+{
+    patchSearches.removeOne(static_cast<PatchSearch*>(sender()));
+    if (patchSearches.isEmpty())
+        emit patchFilterDone();
 }
 
 bool Git::resetCommits(int parentDepth)
@@ -1682,7 +1994,6 @@ const QString Git::getBaseDir(bool* changed, SCRef wd, bool* ok, QString* gd) {
 }
 
 Reference* Git::lookupReference(const ShaString& sha, bool create) {
-/* Note: if create flag is set then sha MUST point to persistent data */
 
     ShaMap::iterator it(shaMap.find(sha));
     if (it == shaMap.end() && create)
@@ -1721,7 +2032,6 @@ bool Git::getRefs() {
         return false;
 
     shaMap.clear();
-    shaBackupBuf.clear(); // revs are already empty now
 
     QString prevRefSha;
     QStringList patchNames, patchShas;
@@ -1745,7 +2055,7 @@ bool Git::getRefs() {
             continue;
         }
         // one rev could have many tags
-        Reference* cur = lookupReference(toPersistentSha(revSha, shaBackupBuf), optCreate);
+        Reference* cur = lookupReference(ShaString(revSha), optCreate);
 
         if (refName.startsWith("refs/tags/")) {
 
@@ -1762,7 +2072,7 @@ bool Git::getRefs() {
 
                 // tagObj must be removed from ref map
                 if (!prevRefSha.isEmpty())
-                    shaMap.remove(toTempSha(prevRefSha));
+                    shaMap.remove(ShaString(prevRefSha));
 
             } else
                 cur->tags.append(refName.mid(10));
@@ -1815,7 +2125,7 @@ void Git::parseStGitPatches(SCList patchNames, SCList patchShas) {
                 "not found in references list.", patchName);
             continue;
         }
-        const ShaString& ss = toPersistentSha(patchShas.at(pos), shaBackupBuf);
+        const ShaString ss(patchShas.at(pos));
         Reference* cur = lookupReference(ss, optCreate);
         cur->stgitPatch = patchName;
         cur->type |= (applied ? Reference::APPLIED : Reference::UN_APPLIED);
@@ -1862,7 +2172,7 @@ Revision* Git::fakeRevData(SCRef sha, SCList parents, SCRef author, SCRef date,
 
     fh->rowData.append(ba);
     int dummy;
-    Revision* c = new Revision(*ba, 0, idx, &dummy, !isMainHistory(fh));
+    Revision* c = new (fh->arena) Revision(*ba, 0, idx, &dummy, !isMainHistory(fh));
     return c;
 }
 
@@ -1877,7 +2187,7 @@ const Revision* Git::fakeWorkDirRev(SCRef parent, SCRef log, SCRef longLog, int
     QStringList parents(parent);
     Revision* c = fakeRevData(ZERO_SHA, parents, author, date, log, longLog, patch, idx, fh);
     c->isDiffCache = true;
-    c->lanes.append(LANE_EMPTY);
+    c->lanes.append(LANE_EMPTY, fh->arena);
     return c;
 }
 
@@ -1890,7 +2200,7 @@ const RevFile* Git::fakeWorkDirRevFile(const WorkingDirInfo& wd) {
 
     FOREACH_SL (it, wd.otherFiles) {
 
-        appendFileName(*rf, *it, fl);
+        appendFileName(*rf, (*it).toAscii(), fl);
         rf->status.append(RevFile::UNKNOWN);
         rf->mergeParent.append(1);
     }
@@ -1917,12 +2227,12 @@ void Git::getDiffIndex() {
     head = head.trimmed();
     if (!head.isEmpty()) { // repository initialized but still no history
 
-        if (!run("git diff-index " + head, &workingDirInfo.diffIndex))
+        if (!run(&workingDirInfo.diffIndex, "git diff-index " + head))
             return;
 
         // check for files already updated in cache, we will
         // save this information in status third field
-        if (!run("git diff-index --cached " + head, &workingDirInfo.diffIndexCached))
+        if (!run(&workingDirInfo.diffIndexCached, "git diff-index --cached " + head))
             return;
     }
     // get any file not in tree
@@ -1942,9 +2252,17 @@ void Git::getDiffIndex() {
     emit newRevsAdded(revData, revData->revOrder);
 }
 
-void Git::parseDiffFormatLine(RevFile& rf, SCRef line, int parNum, FileNamesLoader& fl) {
+bool Git::parseDiffFormatLine(RevFile& rf, const char* line, int len, int parNum, PathsVect& paths) {
+/*
+   Parses a 'git diff-tree' raw format line like
+
+       :100644 100644 <sha> <sha> M\tpath
 
-    if (line[1] == ':') { // it's a combined merge
+   working directly on bytes. Paths are appended to 'paths' as raw
+   data pointing into 'line', so they are valid as long as the buffer
+   is. Thread safe, called also by DiffTreeLoader worker threads.
+*/
+    if (len > 1 && line[1] == ':') { // it's a combined merge
 
         /* For combined merges rename/copy information is useless
          * because nor the original file name, nor similarity info
@@ -1953,25 +2271,33 @@ void Git::parseDiffFormatLine(RevFile& rf, SCRef line, int parNum, FileNamesLoad
          * be RM or MR). For visualization purposes we could consider
          * the file as modified
          */
-        appendFileName(rf, line.section('\t', -1), fl);
-        setStatus(rf, "M");
-        rf.mergeParent.append(parNum);
-    } else { // faster parsing in normal case
+        int tab = len - 1;
+        while (tab > 0 && line[tab] != '\t')
+            tab--;
 
-        if (line.at(98) == '\t') {
-            appendFileName(rf, line.mid(99), fl);
-            setStatus(rf, line.at(97));
-            rf.mergeParent.append(parNum);
-        } else
-            // it's a rename or a copy, we are not in fast path now!
-            setExtStatus(rf, line.mid(97), parNum, fl);
+        paths.append(QByteArray::fromRawData(line + tab + 1, len - tab - 1));
+        setStatus(rf, 'M');
+        rf.mergeParent.append(parNum);
+        return true;
+    }
+    if (len < 100) {
+        dbp("ASSERT in parseDiffFormatLine, unexpected line %1", QString::fromAscii(line, len));
+        return false;
+    }
+    if (line[98] == '\t') { // faster parsing in normal case
+        paths.append(QByteArray::fromRawData(line + 99, len - 99));
+        setStatus(rf, line[97]);
+        rf.mergeParent.append(parNum);
+        return true;
     }
+    // it's a rename or a copy, we are not in fast path now!
+    return setExtStatus(rf, line + 97, len - 97, parNum, paths);
 }
 
 // TODO: move into RevFile ?
-void Git::setStatus(RevFile& rf, SCRef rowSt) {
+void Git::setStatus(RevFile& rf, char status) {
+// called also by DiffTreeLoader worker threads
 
-    char status = rowSt.at(0).toLatin1();
     switch (status) {
     case 'M':
     case 'T':
@@ -1992,27 +2318,30 @@ void Git::setStatus(RevFile& rf, SCRef rowSt) {
         break;
     default:
         dbp("ASSERT in Git::setStatus, unknown status <%1>. "
-            "'MODIFIED' will be used instead.", rowSt);
+            "'MODIFIED' will be used instead.", QString(QChar(status)));
         rf.status.append(RevFile::MODIFIED);
         break;
     }
 }
 
 // TODO: move into RevFile ?
-void Git::setExtStatus(RevFile& rf, SCRef rowSt, int parNum, FileNamesLoader& fl) {
-
-    const QStringList sl(rowSt.split('\t', QString::SkipEmptyParts));
-    if (sl.count() != 3) {
-        dbp("ASSERT in setExtStatus, unexpected status string %1", rowSt);
-        return;
+bool Git::setExtStatus(RevFile& rf, const char* rowSt, int len, int parNum, PathsVect& paths) {
+
+    // git give us something like "Rxx\t<orig>\t<dest>"
+    const char* end = rowSt + len;
+    const char* orig = (const char*)memchr(rowSt, '\t', len);
+    const char* dest = (orig ? (const char*)memchr(orig + 1, '\t', end - orig - 1) : NULL);
+    if (!dest || dest == orig + 1 || dest + 1 == end) {
+        dbp("ASSERT in setExtStatus, unexpected status string %1", QString::fromAscii(rowSt, len));
+        return false;
     }
     // we want store extra info with format "orig --> dest (Rxx%)"
-    // but git give us something like "Rxx\t<orig>\t<dest>"
-    SCRef type = sl[0];
-    SCRef orig = sl[1];
-    SCRef dest = sl[2];
-    const QString extStatusInfo(orig + " --> " + dest + " (" + type + "%)");
-
+    const QByteArray type(QByteArray::fromRawData(rowSt, orig - rowSt));
+    const QByteArray origPath(QByteArray::fromRawData(orig + 1, dest - orig - 1));
+    const QByteArray destPath(QByteArray::fromRawData(dest + 1, end - dest - 1));
+    const QString extStatusInfo(QString::fromAscii(origPath) + " --> " +
+                                QString::fromAscii(destPath) + " (" +
+                                QString::fromAscii(type) + "%)");
     /*
        NOTE: we set rf.extStatus size equal to position of latest
              copied/renamed file. So it can have size lower then
@@ -2022,43 +2351,56 @@ void Git::setExtStatus(RevFile& rf, SCRef rowSt, int parNum, FileNamesLoader& fl
     */
 
     // simulate new file
-    appendFileName(rf, dest, fl);
+    paths.append(destPath);
     rf.mergeParent.append(parNum);
     rf.status.append(RevFile::NEW);
     rf.extStatus.resize(rf.status.size());
     rf.extStatus[rf.status.size() - 1] = extStatusInfo;
 
     // simulate deleted orig file only in case of rename
-    if (type.at(0) == 'R') { // renamed file
-        appendFileName(rf, orig, fl);
+    if (*rowSt == 'R') { // renamed file
+        paths.append(origPath);
         rf.mergeParent.append(parNum);
         rf.status.append(RevFile::DELETED);
         rf.extStatus.resize(rf.status.size());
         rf.extStatus[rf.status.size() - 1] = extStatusInfo;
     }
     rf.onlyModified = false;
+    return true;
 }
 
-void Git::parseDiffFormat(RevFile& rf, SCRef buf, FileNamesLoader& fl) {
+void Git::parseDiffFormat(RevFile& rf, const QByteArray& buf, FileNamesLoader& fl) {
+
+    PathsVect paths;
+    const char* data = buf.constData();
+    const int size = buf.size();
+    int parNum = 1, start = 0;
 
-    int parNum = 1, startPos = 0, endPos = buf.indexOf('\n');
-    while (endPos != -1) {
+    while (start < size) {
 
-        SCRef line = buf.mid(startPos, endPos - startPos);
-        if (line[0] == ':') // avoid sha's in merges output
-            parseDiffFormatLine(rf, line, parNum, fl);
+        const char* eol = (const char*)memchr(data + start, '\n', size - start);
+        int end = (eol ? eol - data : size);
+
+        if (data[start] == ':') // avoid sha's in merges output
+            parseDiffFormatLine(rf, data + start, end - start, parNum, paths);
         else
             parNum++;
 
-        startPos = endPos + 1;
-        endPos = buf.indexOf('\n', endPos + 99);
+        start = end + 1;
     }
+    for (int i = 0; i < paths.count(); i++)
+        appendFileName(rf, paths.at(i), fl);
 }
 
 bool Git::startParseProc(SCList initCmd, FileHistory* fh, SCRef buf) {
 
     DataLoader* dl = new DataLoader(this, fh); // auto-deleted when done
 
+    if (isMainHistory(fh) && revsCache.data) {
+        dl->appendCachedRecords(revsCache.data);
+        revsCache.data = NULL;
+    }
+
     connect(this, SIGNAL(cancelLoading(const FileHistory*)),
             dl, SLOT(on_cancel(const FileHistory*)));
 
@@ -2097,8 +2439,12 @@ bool Git::startRevList(SCList args, FileHistory* fh) {
        the file deletion revision.
     */
         initCmd << QString("-r -m -p --full-index").split(' ');
-    } else
-        {} // initCmd << QString("--early-output"); currently disabled
+    } else if (revsCache.data)
+        // cached tips are in '--not' list but cached
+        // revisions will be loaded in full, no boundary
+        initCmd.removeAll("--boundary");
+
+    // initCmd << QString("--early-output"); currently disabled
 
     return startParseProc(initCmd + args, fh, QString());
 }
@@ -2123,6 +2469,121 @@ bool Git::startUnappliedList() {
     return startParseProc(sl, revData, QString());
 }
 
+bool Git::resolveTips(SCList args, QStringList& tips) {
+
+    // 'git rev-parse' passes through anything is not a plain rev, as
+    // options, paths, ranges and negated revs, so we want only sha's back
+    QString runOutput;
+    errorReportingEnabled = false;
+    bool ok = run("git rev-parse " + (args.isEmpty() ? QString("HEAD") : args.join(" ")), &runOutput);
+    errorReportingEnabled = true;
+    if (!ok)
+        return false;
+
+    tips = runOutput.split('\n', QString::SkipEmptyParts);
+    FOREACH_SL (it, tips)
+        if (it->length() != ShaString::HEX_SIZE || ShaString(*it).isNull())
+            return false;
+
+    return !tips.isEmpty();
+}
+
+bool Git::isRevsCacheValid(SCList cachedTips, SCList tips) {
+
+    // cached revisions must be still reachable from current tips,
+    // as example they could be not after a rebase or a reset
+    if (cachedTips.toSet().subtract(tips.toSet()).isEmpty())
+        return true;
+
+    QString lostRevs;
+    errorReportingEnabled = false;
+    bool ok = run("git rev-list -n1 " + cachedTips.join(" ") + " --not " + tips.join(" "), &lostRevs);
+    errorReportingEnabled = true;
+    return (ok && lostRevs.trimmed().isEmpty());
+}
+
+void Git::loadRevsCache(QStringList& args) {
+/*
+   When loading arguments are just refs, as 'HEAD' or '--all', already
+   known revisions are taken from the ones loaded before a refresh, see
+   init(), or from the revisions cache file, and 'git log' is run only
+   for the revisions not reachable from their tips. Then known records
+   are parsed by DataLoader after 'git log' output. Arguments are changed
+   accordingly. Ranges, options and filtered loading are not cached.
+*/
+    QByteArray* data = revsCache.data;
+    QStringList tips, cachedTips(revsCache.dataTips);
+    revsCache.data = NULL;
+
+    bool cacheable = !isStGIT && !loadArguments.filteredLoading && resolveTips(args, tips);
+
+    if (data && (!cacheable || args != revsCache.args || !isRevsCacheValid(cachedTips, tips))) {
+        delete data;
+        data = NULL;
+    }
+    revsCache.args = args;
+    revsCache.tips = tips; // empty if not cacheable
+    if (!cacheable)
+        return;
+
+    if (!data) {
+        data = Cache::loadRevs(gitDir, args, cachedTips);
+        revsCache.savedTips = (data ? cachedTips : QStringList());
+
+        if (data && !isRevsCacheValid(cachedTips, tips)) {
+            delete data;
+            return;
+        }
+    }
+    if (!data)
+        return;
+
+    revsCache.data = data;
+    args = tips;
+    args << "--not" << cachedTips;
+}
+
+void Git::cacheableRevs(QVector<const Revision*>& v) {
+
+    v.reserve(revData->revOrder.count());
+    FOREACH (ShaVect, it, revData->revOrder) {
+
+        const Revision* r = revLookup(*it);
+        if (r && !r->isDiffCache && !r->isBoundary())
+            v.append(r);
+    }
+}
+
+QByteArray* Git::revsSnapshot() {
+// a copy of the records of the loaded revisions, in loading order
+
+    QVector<const Revision*> v;
+    cacheableRevs(v);
+
+    int size = 0;
+    for (int i = 0; i < v.count(); ++i)
+        size += v.at(i)->rawRecord().size();
+
+    QByteArray* ba = new QByteArray();
+    ba->reserve(size);
+    for (int i = 0; i < v.count(); ++i)
+        ba->append(v.at(i)->rawRecord());
+
+    return ba;
+}
+
+void Git::saveRevsCache() {
+
+    QVector<const Revision*> v;
+    cacheableRevs(v);
+
+    SHOW_MSG("Saving revisions cache. Please wait...");
+    if (Cache::saveRevs(gitDir, revsCache.args, revsCache.tips, v))
+        revsCache.savedTips = revsCache.tips;
+    else
+        dbs("ERROR unable to save revisions cache");
+}
+
 void Git::stop(bool saveCache) {
 // normally called when changing directory or closing
 
@@ -2131,45 +2592,59 @@ void Git::stop(bool saveCache) {
     // stop all data sending from process and asks them
     // to terminate. Note that process could still keep
     // running for a while although silently
+    stopPatchFilter();
     emit cancelAllProcesses(); // non blocking
+    stopTreeIndex();
 
     // after cancelAllProcesses() procFinished() is not called anymore
     // TODO perhaps is better to call procFinished() also if process terminated
     // incorrectly as QProcess does. BUt first we need to fix FileView::on_loadCompleted()
     emit fileNamesLoad(1, revsFiles.count() - filesLoadingStartOfs);
 
+    filesLoadingActive = 0; // loaders are canceled, a revision is added only when complete
+
     if (cacheNeedsUpdate && saveCache) {
 
         cacheNeedsUpdate = false;
-        if (!filesLoadingCurSha.isEmpty()) // we are in the middle of a loading
-            revsFiles.remove(toTempSha(filesLoadingCurSha)); // remove partial data
-
-        if (!revsFiles.isEmpty()) {
-            SHOW_MSG("Saving cache. Please wait...");
-            if (!Cache::save(gitDir, revsFiles, dirNamesVec, fileNamesVec))
-                dbs("ERROR unable to save file names cache");
-        }
+        // written by a worker thread, errors are reported later
+        if (!revsFiles.isEmpty() && !fileCache->append(revsFiles, dirNamesVec, fileNamesVec))
+            dbs("ERROR unable to save file names cache");
     }
+    if (   saveCache
+        && revsCache.loaded
+        && !revsCache.tips.isEmpty()
+        &&  revsCache.tips.toSet() != revsCache.savedTips.toSet())
+        saveRevsCache();
 }
 
 void Git::clearRevs() {
 
+    stopTreeIndex();
+    clearPathIndex(); // orderIdx will change
+    clearLogIndex();
     revData->clear();
     patchesStillToFind = 0; // TODO TEST WITH FILTERING
     firstNonStGitPatch = "";
     workingDirInfo.clear();
     revsFiles.remove(ZERO_SHA_RAW);
+    revsCache.loaded = false;
 }
 
 void Git::clearFileNames() {
 
     qDeleteAll(revsFiles);
     revsFiles.clear();
+    qDeleteAll(mergeFiles);
+    mergeFiles.clear();
+    delete customFiles;
+    customFiles = NULL;
     fileNamesMap.clear();
     dirNamesMap.clear();
     dirNamesVec.clear();
     fileNamesVec.clear();
-    revsFilesShaBackupBuf.clear();
+    pathTrie.clear();
+    clearPathIndex();
+    fileCache->close();
     cacheNeedsUpdate = false;
 }
 
@@ -2177,6 +2652,14 @@ bool Git::init(SCRef wd, bool askForRange, const QStringList* passedArgs, bool o
 // normally called when changing git directory. Must be called after stop()
 
     *quit = false;
+
+    // on refresh already loaded revisions are not asked again to git
+    delete revsCache.data;
+    revsCache.data = NULL;
+    if (wd == workDir && revsCache.loaded && !revsCache.tips.isEmpty()) {
+        revsCache.data = revsSnapshot();
+        revsCache.dataTips = revsCache.tips;
+    }
     clearRevs();
 
     /* we only update filtering info here, original arguments
@@ -2292,6 +2775,8 @@ void Git::init2() {
 
             args << loadArguments.filterList;
         }
+        loadRevsCache(args); // could change args to load only new revisions
+
         if (!startRevList(args, revData))
             SHOW_MSG("ERROR: unable to start 'git log'");
 
@@ -2339,13 +2824,30 @@ void Git::on_loaded(FileHistory* fh, ulong byteSize, int loadTime,
                         "time elapsed: %i ms  (%.2f MB/s)",
                         fh->revs.count(), kb, fh->loadTime, mbs);
 
-            if (!tryFollowRenames(fh))
+            if (!tryFollowRenames(fh)) {
+
                 emit loadCompleted(fh, tmp);
 
-            if (isMainHistory(fh))
+                // revOrder is final now, checkpoint lanes in background
+                // over a copy, so that the worker never reads fh->revOrder
+                if (fh->revOrder.count() > LANES_CHECKPOINT_STEP) {
+                    const ShaVect& ro(fh->revOrder);
+                    QVector<const Revision*> revs(ro.count());
+                    for (int i = 0; i < ro.count(); i++)
+                        revs[i] = fh->revs.value(ro.at(i));
+
+                    fh->lanesPrecompute = QtConcurrent::run(&Git::precomputeLanes, fh, revs);
+                }
+            }
+
+            if (isMainHistory(fh)) {
+
+                revsCache.loaded = true;
+
                 // wait the dust to settle down before to start
                 // background file names loading for new revisions
                 QTimer::singleShot(500, this, SLOT(loadFileNames()));
+            }
         }
     }
     if (loadingUnAppliedPatches) {
@@ -2433,10 +2935,10 @@ bool Git::populateRenamedPatches(SCRef renamedSha, SCList newNames, FileHistory*
 void Git::populateFileNamesMap() {
 
     for (int i = 0; i < dirNamesVec.count(); ++i)
-        dirNamesMap.insert(dirNamesVec[i], i);
+        dirNamesMap.insert(dirNamesVec[i].toAscii(), i);
 
     for (int i = 0; i < fileNamesVec.count(); ++i)
-        fileNamesMap.insert(fileNamesVec[i], i);
+        fileNamesMap.insert(fileNamesVec[i].toAscii(), i);
 }
 
 void Git::loadFileCache() {
@@ -2444,46 +2946,107 @@ void Git::loadFileCache() {
     if (!fileCacheAccessed) {
 
         fileCacheAccessed = true;
-        QByteArray shaBuf;
-        if (Cache::load(gitDir, revsFiles, dirNamesVec, fileNamesVec, shaBuf)) {
-            revsFilesShaBackupBuf.append(shaBuf);
+        pathTrie.clear(); // names are reloaded
+        clearPathIndex();
+        if (fileCache->open(gitDir, dirNamesVec, fileNamesVec))
             populateFileNamesMap();
-        } else
+        else
             dbs("ERROR: unable to load file names cache");
     }
 }
 
 void Git::loadFileNames() {
 
-    indexTree(); // we are sure data loading is finished at this point
+    startTreeIndex(); // we are sure data loading is finished at this point
 
-    int revCnt = 0;
-    QString diffTreeBuf;
+    QStringList shas;
     FOREACH (ShaVect, it, revData->revOrder) {
 
-        if (!revsFiles.contains(*it)) {
+        if (!hasRevFile(*it)) {
             const Revision* c = revLookup(*it);
-            if (c->parentsCount() == 1) { // skip initials and merges
-                diffTreeBuf.append(*it).append('\n');
-                revCnt++;
-            }
+            if (c->parentsCount() == 1) // skip initials and merges
+                shas.append(*it);
         }
     }
-    if (!diffTreeBuf.isEmpty()) {
-        filesLoadingPending = filesLoadingCurSha = "";
-        filesLoadingStartOfs = revsFiles.count();
-        emit fileNamesLoad(3, revCnt);
+    if (shas.isEmpty() || filesLoadingActive)
+        return;
 
-        const QString runCmd("git diff-tree --no-color -r -C --stdin");
-        runAsync(runCmd, this, diffTreeBuf);
+    filesLoadingStartOfs = revsFiles.count();
+    emit fileNamesLoad(3, shas.count());
+
+    // split revisions in contiguous ranges, one 'git diff-tree'
+    // for each range, but don't bother for few revisions
+    int shards = qBound(1, QThread::idealThreadCount(), MAX_DIFF_TREE_PROCS);
+    shards = qMin(shards, 1 + shas.count() / MIN_DIFF_TREE_SHARD);
+    int shardSize = (shas.count() + shards - 1) / shards;
+
+    for (int i = 0; i < shas.count(); i += shardSize) {
+
+        const QString buf(QStringList(shas.mid(i, shardSize)).join("\n").append('\n'));
+        DiffTreeLoader* dl = new DiffTreeLoader(this); // auto-deleted when done
+        connect(dl, SIGNAL(loaded()), this, SLOT(on_fileNamesLoaded()));
+        if (dl->start(buf))
+            filesLoadingActive++;
+        else
+            delete dl;
+    }
+    if (!filesLoadingActive)
+        emit fileNamesLoad(1, 0);
+}
+
+void Git::mergeFileNames(DiffTreeBatch& batch) {
+// called by DiffTreeLoader in GUI thread, only file names indexing is left
+
+    for (int i = 0; i < batch.revs.count(); i++) {
+
+        DiffTreeRev& r = batch.revs[i];
+        if (hasRevFile(r.sha)) {
+            dbp("ASSERT: repeated sha %1 in file names loading", r.sha.toString());
+            delete r.rf;
+            continue;
+        }
+        for (int y = 0; y < r.paths.count(); y++)
+            appendFileName(*r.rf, r.paths.at(y), fileLoader);
+
+        flushFileNames(fileLoader);
+        revsFiles.insert(r.sha, r.rf);
+        indexRevFile(r.sha, *r.rf);
     }
+    if (!batch.revs.isEmpty())
+        cacheNeedsUpdate = true;
+
+    emit fileNamesLoad(2, revsFiles.count() - filesLoadingStartOfs);
+}
+
+bool Git::hasRevFile(const ShaString& sha) const {
+
+    return revsFiles.contains(sha) || fileCache->contains(sha);
+}
+
+const RevFile* Git::revFile(const ShaString& sha) {
+// cached revisions are decoded on first access
+
+    RevFileMap::const_iterator it(revsFiles.constFind(sha));
+    if (it != revsFiles.constEnd())
+        return *it;
+
+    RevFile* rf = fileCache->decode(sha);
+    if (rf)
+        revsFiles.insert(sha, rf);
+    return rf;
+}
+
+void Git::on_fileNamesLoaded() {
+
+    if (--filesLoadingActive == 0)
+        emit fileNamesLoad(1, revsFiles.count() - filesLoadingStartOfs);
 }
 
 bool Git::filterEarlyOutputRev(FileHistory* fh, Revision* rev) {
 
     if (fh->earlyOutputCnt < fh->revOrder.count()) {
 
-        const ShaString& sha = fh->revOrder[fh->earlyOutputCnt++];
+        const ShaString& sha = fh->revOrder.at(fh->earlyOutputCnt++);
         const Revision* c = revLookup(sha, fh);
         if (c) {
             if (rev->sha() != sha || rev->parents() != c->parents()) {
@@ -2491,6 +3054,8 @@ bool Git::filterEarlyOutputRev(FileHistory* fh, Revision* rev) {
                 // overwrite 'c' upon returning
                 rev->orderIdx = c->orderIdx;
                 revData->clear(false); // flush the tail
+                clearPathIndex();
+                clearLogIndex();
             } else
                 return true; // filter out 'rev'
         }
@@ -2502,42 +3067,51 @@ bool Git::filterEarlyOutputRev(FileHistory* fh, Revision* rev) {
 
 int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
 
-    RevMap& r = fh->revs;
     int nextStart;
     Revision* rev;
 
+    // only here we create a new rev, memory of a not complete
+    // one is given back, a filtered out one is reclaimed with the arena
+    void* mem = fh->arena.alloc(sizeof(Revision));
     do {
-        // only here we create a new rev
-        rev = new Revision(ba, start, fh->revOrder.count(), &nextStart, !isMainHistory(fh));
+        rev = new (mem) Revision(ba, start, fh->revOrder.count(), &nextStart, !isMainHistory(fh));
 
         if (nextStart == -2) {
-            delete rev;
+            rev->~Revision();
             fh->setEarlyOutputState(true);
             start = ba.indexOf('\n', start) + 1;
         }
 
     } while (nextStart == -2);
 
-    if (nextStart == -1) { // half chunk detected
-        delete rev;
+    if (nextStart == -1) { // half chunk detected, will be parsed again
+        rev->~Revision();
+        fh->arena.release(mem, sizeof(Revision));
         return -1;
     }
 
+    addRevision(fh, rev);
+    return nextStart;
+}
+
+void Git::addRevision(FileHistory* fh, Revision* rev) {
+// rev could have been indexed by a DataLoader worker thread, but
+// insertion is always done here, in the same order of 'git log'.
+// A filtered out rev is simply dropped, it lives in fh->arena
+
+    RevMap& r = fh->revs;
+    rev->orderIdx = fh->revOrder.count();
     const ShaString& sha = rev->sha();
 
-    if (fh->earlyOutputCnt != -1 && filterEarlyOutputRev(fh, rev)) {
-        delete rev;
-        return nextStart;
-    }
+    if (fh->earlyOutputCnt != -1 && filterEarlyOutputRev(fh, rev))
+        return;
 
     if (isStGIT) {
         if (loadingUnAppliedPatches) { // filter out possible spurious revs
 
             Reference* rf = lookupReference(sha);
-            if (!(rf && (rf->type & Reference::UN_APPLIED))) {
-                delete rev;
-                return nextStart;
-            }
+            if (!(rf && (rf->type & Reference::UN_APPLIED)))
+                return;
         }
         // remove StGIT spurious revs filter
         if (!firstNonStGitPatch.isEmpty() && firstNonStGitPatch == sha)
@@ -2550,18 +3124,14 @@ int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
             !loadingUnAppliedPatches && isMainHistory(fh)) {
 
             Reference* rf = lookupReference(sha);
-            if (!(rf && (rf->type & Reference::APPLIED))) {
-                delete rev;
-                return nextStart;
-            }
+            if (!(rf && (rf->type & Reference::APPLIED)))
+                return;
         }
         if (r.contains(sha)) {
             // StGIT unapplied patches could be sent again by
             // 'git log' as example if called with --all option.
-            if (r[sha]->isUnApplied) {
-                delete rev;
-                return nextStart;
-            }
+            if (r[sha]->isUnApplied)
+                return;
             // could be a side effect of 'git log -m', see below
             if (isMainHistory(fh) || rev->parentsCount() < 2)
                 dbp("ASSERT: addChunk sha <%1> already received", sha);
@@ -2584,7 +3154,7 @@ int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
 
         r.insert(sha, c); // overwrite old content
         fh->renamedPatches.remove(sha);
-        return nextStart;
+        return;
     }
     if (!isMainHistory(fh) && rev->parentsCount() > 1 && r.contains(sha)) {
     /* In this case git log is called with -m option and merges are splitted
@@ -2593,14 +3163,7 @@ int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
        but we nevertheless add all the commits to 'r' so that annotation code
        can get the patches.
     */
-        QString mergeSha;
-        int i = 0;
-        do
-            mergeSha = QString::number(++i) + " m " + sha;
-        while (r.contains(toTempSha(mergeSha)));
-
-        const ShaString& ss = toPersistentSha(mergeSha, shaBackupBuf);
-        r.insert(ss, rev);
+        fh->mergeRevs[sha].append(rev);
     } else {
         r.insert(sha, rev);
         fh->revOrder.append(sha);
@@ -2615,7 +3178,7 @@ int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
 
             Revision* c = const_cast<Revision*>(revLookup(sha, fh));
             c->isUnApplied = true;
-            c->lanes.append(LANE_UNAPPLIED);
+            c->lanes.append(LANE_UNAPPLIED, fh->arena);
 
         } else if (patchesStillToFind > 0 || !isMainHistory(fh)) { // try to avoid costly lookup
 
@@ -2634,7 +3197,6 @@ int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
             }
         }
     }
-    return nextStart;
 }
 
 bool Git::copyDiffIndex(FileHistory* fh, SCRef parent) {
@@ -2660,19 +3222,43 @@ bool Git::copyDiffIndex(FileHistory* fh, SCRef parent) {
 }
 
 void Git::setLane(SCRef sha, FileHistory* fh) {
+/*
+   Lanes of a row depend on the ones of all the rows above, so they are
+   computed walking revOrder. Lanes state is valid only at firstFreeLane,
+   to reach a row above it or far below we restart from the nearest
+   checkpoint, saved here or by precomputeLanes(), so that at most
+   LANES_CHECKPOINT_STEP rows are walked once checkpoints are available.
+*/
+    const ShaString ss(sha);
+    const Revision* target = revLookup(ss, fh);
+    if (!target)
+        return;
 
     Lanes* l = fh->lns;
-    uint i = fh->firstFreeLane;
-    QVector<QByteArray> ba;
-    const ShaString& ss = toPersistentSha(sha, ba);
+    int i = fh->firstFreeLane;
+    int row = target->orderIdx;
+
+    if (row < i || row - i >= LANES_CHECKPOINT_STEP) {
+
+        Lanes cp;
+        int cpRow = fh->lanesCheckpoint(row, &cp);
+        if (cpRow == -1 && row < i) {
+            l->clear();
+            i = 0;
+        } else if (cpRow > i || (cpRow != -1 && row < i)) {
+            *l = cp;
+            i = cpRow;
+        }
+    }
     const ShaVect& shaVec(fh->revOrder);
 
-    for (uint cnt = shaVec.count(); i < cnt; ++i) {
+    for (int cnt = shaVec.count(); i < cnt; ++i) {
+
+        if (i % LANES_CHECKPOINT_STEP == 0)
+            fh->addLanesCheckpoint(i, *l);
 
         const ShaString& curSha = shaVec[i];
-        Revision* r = const_cast<Revision*>(revLookup(curSha, fh));
-        if (r->lanes.count() == 0)
-            updateLanes(*r, *l, curSha);
+        updateLanes(*revLookup(curSha, fh), *l, &fh->arena);
 
         if (curSha == ss)
             break;
@@ -2680,10 +3266,31 @@ void Git::setLane(SCRef sha, FileHistory* fh) {
     fh->firstFreeLane = ++i;
 }
 
-void Git::updateLanes(Revision& c, Lanes& lns, SCRef sha) {
-// we could get third argument from c.sha(), but we are in fast path here
-// and c.sha() involves a deep copy, so we accept a little redundancy
+void Git::precomputeLanes(FileHistory* fh, const QVector<const Revision*>& revs) {
+/*
+   Runs in a worker thread once loading is completed, walks the whole
+   graph only to save lanes state checkpoints, so revisions are not
+   modified. Lanes of the rows are then stored by setLane() on demand.
+   Revisions in graph order are collected by GUI thread, fh is used only
+   for the checkpoints.
+*/
+    Lanes l;
+    for (int i = 0; i < revs.count() && !fh->lanesCanceled; ++i) {
+
+        if (i % LANES_CHECKPOINT_STEP == 0)
+            fh->addLanesCheckpoint(i, l);
+
+        updateLanes(*revs.at(i), l, NULL);
+    }
+}
+
+void Git::updateLanes(const Revision& c, Lanes& lns, RevArena* arena) {
+// without an arena only lanes state is updated, see precomputeLanes()
+
+    if (c.isDiffCache || c.isUnApplied)
+        return; // fixed lanes, not part of the graph
 
+    const ShaString& sha = c.sha();
     if (lns.isEmpty())
         lns.init(sha);
 
@@ -2699,16 +3306,22 @@ void Git::updateLanes(Revision& c, Lanes& lns, SCRef sha) {
 
     if (isFork)
         lns.setFork(sha);
-    if (isMerge)
-        lns.setMerge(c.parents());
+    if (isMerge) {
+        QVector<ShaString> parents(c.parentsCount());
+        for (uint i = 0; i < c.parentsCount(); i++)
+            parents[i] = c.parent(i);
+
+        lns.setMerge(parents);
+    }
     if (c.isApplied)
         lns.setApplied();
     if (isInitial)
         lns.setInitial();
 
-    lns.getLanes(c.lanes); // here lanes are snapshotted
+    if (arena && c.lanes.isEmpty()) // here lanes are snapshotted
+        const_cast<Revision&>(c).lanes.assign(lns.getLanes(), *arena);
 
-    SCRef nextSha = (isInitial) ? "" : QString(c.parent(0));
+    const ShaString nextSha = (isInitial) ? ShaString() : c.parent(0);
 
     lns.nextParent(nextSha);
 
@@ -2729,50 +3342,6 @@ void Git::updateLanes(Revision& c, Lanes& lns, SCRef sha) {
 //    qDebug("%s %s", tmp.toUtf8().data(), sha.toUtf8().data());
 }
 
-void Git::procFinished() {
-
-    flushFileNames(fileLoader);
-    filesLoadingPending = filesLoadingCurSha = "";
-    emit fileNamesLoad(1, revsFiles.count() - filesLoadingStartOfs);
-}
-
-void Git::procReadyRead(const QByteArray& fileChunk) {
-
-    if (filesLoadingPending.isEmpty())
-        filesLoadingPending = fileChunk;
-    else
-        filesLoadingPending.append(fileChunk); // add to previous half lines
-
-    RevFile* rf = NULL;
-    if (!filesLoadingCurSha.isEmpty() && revsFiles.contains(toTempSha(filesLoadingCurSha)))
-        rf = const_cast<RevFile*>(revsFiles[toTempSha(filesLoadingCurSha)]);
-
-    int nextEOL = filesLoadingPending.indexOf('\n');
-    int lastEOL = -1;
-    while (nextEOL != -1) {
-
-        SCRef line(filesLoadingPending.mid(lastEOL + 1, nextEOL - lastEOL - 1));
-        if (line.at(0) != ':') {
-            SCRef sha = line.left(40);
-            if (!rf || sha != filesLoadingCurSha) { // new commit
-                rf = new RevFile();
-                revsFiles.insert(toPersistentSha(sha, revsFilesShaBackupBuf), rf);
-                filesLoadingCurSha = sha;
-                cacheNeedsUpdate = true;
-            } else
-                dbp("ASSERT: repeated sha %1 in file names loading", sha);
-        } else // line.constref(0) == ':'
-            parseDiffFormatLine(*rf, line, 1, fileLoader);
-
-        lastEOL = nextEOL;
-        nextEOL = filesLoadingPending.indexOf('\n', lastEOL + 1);
-    }
-    if (lastEOL != -1)
-        filesLoadingPending.remove(0, lastEOL + 1);
-
-    emit fileNamesLoad(2, revsFiles.count() - filesLoadingStartOfs);
-}
-
 void Git::flushFileNames(FileNamesLoader& fl) {
 
     if (!fl.rf)
@@ -2796,21 +3365,22 @@ void Git::flushFileNames(FileNamesLoader& fl) {
     fl.rf = NULL;
 }
 
-void Git::appendFileName(RevFile& rf, SCRef name, FileNamesLoader& fl) {
+void Git::appendFileName(RevFile& rf, const QByteArray& name, FileNamesLoader& fl) {
+// names are looked up by their raw bytes, a QString is created only for new ones
 
     if (fl.rf != &rf) {
         flushFileNames(fl);
         fl.rf = &rf;
     }
     int idx = name.lastIndexOf('/') + 1;
-    SCRef dr = name.left(idx);
-    SCRef nm = name.mid(idx);
+    const QByteArray dr(QByteArray::fromRawData(name.constData(), idx));
+    const QByteArray nm(QByteArray::fromRawData(name.constData() + idx, name.size() - idx));
 
-    QHash<QString, int>::const_iterator it(dirNamesMap.constFind(dr));
+    QHash<QByteArray, int>::const_iterator it(dirNamesMap.constFind(dr));
     if (it == dirNamesMap.constEnd()) {
         int idx = dirNamesVec.count();
-        dirNamesMap.insert(dr, idx);
-        dirNamesVec.append(dr);
+        dirNamesMap.insert(QByteArray(dr.constData(), dr.size()), idx); // deep copy
+        dirNamesVec.append(QString::fromAscii(dr));
         fl.rfDirs.append(idx);
     } else
         fl.rfDirs.append(*it);
@@ -2818,203 +3388,60 @@ void Git::appendFileName(RevFile& rf, SCRef name, FileNamesLoader& fl) {
     it = fileNamesMap.constFind(nm);
     if (it == fileNamesMap.constEnd()) {
         int idx = fileNamesVec.count();
-        fileNamesMap.insert(nm, idx);
-        fileNamesVec.append(nm);
+        fileNamesMap.insert(QByteArray(nm.constData(), nm.size()), idx);
+        fileNamesVec.append(QString::fromAscii(nm));
         fl.rfNames.append(idx);
     } else
         fl.rfNames.append(*it);
 }
 
-void Git::updateDescMap(const Revision* r,uint idx, QHash<QPair<uint, uint>, bool>& dm,
-                        QHash<uint, QVector<int> >& dv) {
-
-    QVector<int> descVec;
-    if (r->descRefsMaster != -1) {
-
-        const Revision* tmp = revLookup(revData->revOrder[r->descRefsMaster]);
-        const QVector<int>& nr = tmp->descRefs;
-
-        for (int i = 0; i < nr.count(); i++) {
-
-            if (!dv.contains(nr[i])) {
-                dbp("ASSERT descendant for %1 not found", r->sha());
-                return;
-            }
-            const QVector<int>& dvv = dv[nr[i]];
-
-            // copy the whole vector instead of each element
-            // in the first iteration of the loop below
-            descVec = dvv; // quick (shared) copy
-
-            for (int y = 0; y < dvv.count(); y++) {
-
-                uint v = (uint)dvv[y];
-                QPair<uint, uint> key = qMakePair(idx, v);
-                QPair<uint, uint> keyN = qMakePair(v, idx);
-                dm.insert(key, true);
-                dm.insert(keyN, false);
-
-                // we don't want duplicated entry, otherwise 'dvv' grows
-                // greatly in repos with many tagged development branches
-                if (i > 0 && !descVec.contains(v)) // i > 0 is rare, no
-                    descVec.append(v);         // need to optimize
-            }
-        }
-    }
-    descVec.append(idx);
-    dv.insert(idx, descVec);
-}
-
-void Git::mergeBranches(Revision* p, const Revision* r) {
-
-    int r_descBrnMaster = (shaMap.checkRef(r->sha(), Reference::BRANCH | Reference::REMOTE_BRANCH) ? r->orderIdx : r->descBrnMaster);
-
-    if (p->descBrnMaster == r_descBrnMaster || r_descBrnMaster == -1)
+void Git::startTreeIndex() {
+/*
+   Children, descendant branches and nearest tags are computed by a worker
+   thread over a snapshot of the graph, see TreeIndex. The snapshot is
+   only implicitly shared copies, revisions are read but never modified.
+   Until the new index is published by on_treeIndexReady() the related
+   info is reported as being computed.
+*/
+    stopTreeIndex();
+    if (revData->revOrder.isEmpty())
         return;
 
-    // we want all the descendant branches, so just avoid duplicates
-    const QVector<int>& src1 = revLookup(revData->revOrder[p->descBrnMaster])->descBranches;
-    const QVector<int>& src2 = revLookup(revData->revOrder[r_descBrnMaster])->descBranches;
-    QVector<int> dst(src1);
-    for (int i = 0; i < src2.count(); i++)
-        if (qFind(src1.constBegin(), src1.constEnd(), src2[i]) == src1.constEnd())
-            dst.append(src2[i]);
-
-    p->descBranches = dst;
-    p->descBrnMaster = p->orderIdx;
+    treeIndexWatcher.setFuture(QtConcurrent::run(&TreeIndex::build, revData->revOrder,
+                                                 revData->revs, ShaMap(shaMap), optGoDown,
+                                                 &treeIndexGen));
 }
 
-void Git::mergeNearTags(bool down, Revision* p, const Revision* r, const QHash<QPair<uint, uint>, bool>& dm) {
-
-    bool isTag = shaMap.checkRef(r->sha(), Reference::TAG);
-    int r_descRefsMaster = isTag ? r->orderIdx : r->descRefsMaster;
-    int r_ancRefsMaster = isTag ? r->orderIdx : r->ancRefsMaster;
-
-    if (down && (p->descRefsMaster == r_descRefsMaster || r_descRefsMaster == -1))
-        return;
-
-    if (!down && (p->ancRefsMaster == r_ancRefsMaster || r_ancRefsMaster == -1))
-        return;
-
-    // we want the nearest tag only, so remove any tag
-    // that is ancestor of any other tag in p U r
-    const ShaVect& ro = revData->revOrder;
-    const ShaString& sha1 = down ? ro[p->descRefsMaster] : ro[p->ancRefsMaster];
-    const ShaString& sha2 = down ? ro[r_descRefsMaster] : ro[r_ancRefsMaster];
-    const QVector<int>& src1 = down ? revLookup(sha1)->descRefs : revLookup(sha1)->ancRefs;
-    const QVector<int>& src2 = down ? revLookup(sha2)->descRefs : revLookup(sha2)->ancRefs;
-    QVector<int> dst(src1);
-
-    for (int s2 = 0; s2 < src2.count(); s2++) {
-
-        bool add = false;
-        for (int s1 = 0; s1 < src1.count(); s1++) {
-
-            if (src2[s2] == src1[s1]) {
-                add = false;
-                break;
-            }
-            QPair<uint, uint> key = qMakePair((uint)src2[s2], (uint)src1[s1]);
-
-            if (!dm.contains(key)) { // could be empty if all tags are independent
-                add = true; // could be an independent path
-                continue;
-            }
-            add = (down && dm[key]) || (!down && !dm[key]);
-            if (add)
-                dst[s1] = -1; // mark for removing
-            else
-                break;
-        }
-        if (add)
-            dst.append(src2[s2]);
-    }
-    QVector<int>& nearRefs = (down ? p->descRefs : p->ancRefs);
-    int& nearRefsMaster = (down ? p->descRefsMaster : p->ancRefsMaster);
+void Git::stopTreeIndex() {
+/*
+   Must be called before revisions are cleared. A build still running is
+   canceled bumping the generation, one already finished whose result is
+   not yet published is discarded here, its queued finished() signal is
+   then ignored by on_treeIndexReady().
+*/
+    treeIndexGen.ref();
+    treeIndexWatcher.waitForFinished();
 
-    nearRefs.clear();
-    for (int s2 = 0; s2 < dst.count(); s2++)
-        if (dst[s2] != -1)
-            nearRefs.append(dst[s2]);
+    const QFuture<TreeIndex*> f(treeIndexWatcher.future());
+    TreeIndex* t = (f.resultCount() > 0 ? f.result() : NULL);
+    if (t != treeIndex)
+        delete t;
 
-    nearRefsMaster = p->orderIdx;
+    treeIndexWatcher.setFuture(QFuture<TreeIndex*>());
+    delete treeIndex;
+    treeIndex = NULL;
 }
 
-void Git::indexTree() {
+void Git::on_treeIndexReady() {
 
-    const ShaVect& ro = revData->revOrder;
-    if (ro.count() == 0)
+    // signal could come from a build stopped in the meantime
+    const QFuture<TreeIndex*> f(treeIndexWatcher.future());
+    if (!f.isFinished() || f.resultCount() == 0)
         return;
 
-    // we keep the pairs(x, y). Value is true if x is
-    // ancestor of y or false if y is ancestor of x
-    QHash<QPair<uint, uint>, bool> descMap;
-    QHash<uint, QVector<int> > descVect;
-
-    // walk down the tree from latest to oldest,
-    // compute children and nearest descendants
-    for (uint i = 0, cnt = ro.count(); i < cnt; i++) {
-
-        uint type = shaMap.checkRef(ro[i]);
-        bool isB = (type & (Reference::BRANCH | Reference::REMOTE_BRANCH));
-        bool isT = (type & Reference::TAG);
-
-        const Revision* r = revLookup(ro[i]);
-
-        if (isB) {
-            Revision* rr = const_cast<Revision*>(r);
-            if (r->descBrnMaster != -1) {
-                const ShaString& sha = ro[r->descBrnMaster];
-                rr->descBranches = revLookup(sha)->descBranches;
-            }
-            rr->descBranches.append(i);
-        }
-        if (isT) {
-            updateDescMap(r, i, descMap, descVect);
-            Revision* rr = const_cast<Revision*>(r);
-            rr->descRefs.clear();
-            rr->descRefs.append(i);
-        }
-        for (uint y = 0; y < r->parentsCount(); y++) {
-
-            Revision* p = const_cast<Revision*>(revLookup(r->parent(y)));
-            if (p) {
-                p->childs.append(i);
-
-                if (p->descBrnMaster == -1)
-                    p->descBrnMaster = isB ? r->orderIdx : r->descBrnMaster;
-                else
-                    mergeBranches(p, r);
-
-                if (p->descRefsMaster == -1)
-                    p->descRefsMaster = isT ? r->orderIdx : r->descRefsMaster;
-                else
-                    mergeNearTags(optGoDown, p, r, descMap);
-            }
-        }
-    }
-    // walk backward through the tree and compute nearest tagged ancestors
-    for (int i = ro.count() - 1; i >= 0; i--) {
-
-        const Revision* r = revLookup(ro[i]);
-        bool isTag = shaMap.checkRef(ro[i], Reference::TAG);
-
-        if (isTag) {
-            Revision* rr = const_cast<Revision*>(r);
-            rr->ancRefs.clear();
-            rr->ancRefs.append(i);
-        }
-        for (int y = 0; y < r->childs.count(); y++) {
-
-            Revision* c = const_cast<Revision*>(revLookup(ro[r->childs[y]]));
-            if (c) {
-                if (c->ancRefsMaster == -1)
-                    c->ancRefsMaster = isTag ? r->orderIdx:r->ancRefsMaster;
-                else
-                    mergeNearTags(!optGoDown, c, r, descMap);
-            }
-        }
+    TreeIndex* t = f.result(); // NULL if canceled
+    if (t && t != treeIndex && t->generation() == treeIndexGen) {
+        delete treeIndex;
+        treeIndex = t;
     }
 }
-
-
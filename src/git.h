@@ -8,11 +8,19 @@
 #define GIT_H
 
 #include <QAbstractItemModel>
+#include <QFutureWatcher>
 #include "exceptionmanager.h"
 #include "common.h"
+#include "difftreeloader.h"
 #include "domain.h"
+#include "model/pathtrie.h"
+#include "model/revbitmap.h"
 #include "model/revision.h"
+#include "model/revmap.h"
+#include "model/revquery.h"
 #include "model/shamap.h"
+#include "model/trigramindex.h"
+#include "model/treeindex.h"
 //#include "filehistory.h"
 
 template <class, class> struct QPair;
@@ -26,6 +34,7 @@ class Git;
 class Lanes;
 class MyProcess;
 class FileHistory;
+class PatchSearch;
 
 // Need to add in class (conflict in git_startup.cpp)
 
@@ -92,8 +101,12 @@ public:
     MyProcess* getHighlightedFile(SCRef fileSha, QObject* receiver, QString* result, SCRef fileName);
     const QString getFileSha(SCRef file, SCRef revSha);
     bool saveFile(SCRef fileSha, SCRef fileName, SCRef path);
-    void getFileFilter(SCRef path, ShaSet& shaSet) const;
-    bool getPatchFilter(SCRef exp, bool isRegExp, ShaSet& shaSet);
+    void getFileFilter(SCRef path, ShaSet& shaSet);
+    void getFileFilter(const QRegExp& rx, ShaSet& shaSet);
+    int getLogFilter(SCRef filter, int colNum, ShaSet& shaSet);
+    void getQueryFilter(RevQuery& q, ShaSet& shaSet);
+    bool startPatchFilter(SCRef exp, bool isRegExp, const ShaSet* limit = NULL);
+    void stopPatchFilter();
     const RevFile* getFiles(SCRef sha, SCRef sha2 = "", bool all = false, SCRef path = "");
     bool getTree(SCRef ts, TreeInfo& ti, bool wd, SCRef treePath);
     static const QString getLocalDate(SCRef gitDate);
@@ -104,6 +117,9 @@ public:
     const QStringList getChilds(SCRef parent);
     const QStringList getNearTags(bool goDown, SCRef sha);
     const QStringList getDescendantBranches(SCRef sha, bool shaOnly = false);
+    bool isAncestor(SCRef ancestor, SCRef sha);
+    bool ancestryFromIndex(SCRef ancestor, SCRef sha, bool* isAnc);
+    const QString mergeBase(SCRef sha1, SCRef sha2);
     const QString getShortLog(SCRef sha);
     const QString getTagMsg(SCRef sha);
     const Revision* revLookup(const ShaString& sha, const FileHistory* fh = NULL) const;
@@ -134,7 +150,12 @@ public:
 
     const QString filePath(const RevFile& rf, uint i) const
     {
-        return dirNamesVec[rf.dirAt(i)] + fileNamesVec[rf.nameAt(i)];
+        return pathTrie.path(pathNode(rf, i));
+    }
+
+    int pathNode(const RevFile& rf, uint i) const
+    {
+        return pathTrie.fileNode(rf.dirAt(i), rf.nameAt(i));
     }
 
     void setCurContext(Domain* d) { curDomain = d; }
@@ -150,12 +171,10 @@ signals:
     void cancelAllProcesses();
     void annotateReady(Annotate*, bool, const QString&);
     void fileNamesLoad(int, int);
+    void patchFilterFound(const QStringList&);
+    void patchFilterDone();
     void changeFont(const QFont&);
 
-public slots:
-    void procReadyRead(const QByteArray&);
-    void procFinished();
-
 private slots:
     void loadFileCache();
     void loadFileNames();
@@ -163,18 +182,23 @@ private slots:
     void on_getHighlightedFile_eof();
     void on_newDataReady(const FileHistory*);
     void on_loaded(FileHistory*, ulong,int,bool,const QString&,const QString&);
+    void on_treeIndexReady();
+    void on_fileNamesLoaded();
+    void on_patchSearchDone();
 
 private:
     friend class MainImpl;
     friend class DataLoader;
+    friend class DiffTreeLoader;
+    friend class PatchSearch;
     friend class ConsoleImpl;
     friend class RevsView;
 
     struct WorkingDirInfo
     {
-        void clear() { diffIndex = diffIndexCached = ""; otherFiles.clear(); }
-        QString diffIndex;
-        QString diffIndexCached;
+        void clear() { diffIndex.clear(); diffIndexCached.clear(); otherFiles.clear(); }
+        QByteArray diffIndex;
+        QByteArray diffIndexCached;
         QStringList otherFiles;
     };
 
@@ -200,6 +224,20 @@ private:
 
     FileNamesLoader fileLoader;
 
+    struct RevsCache
+    { // known revisions, see loadRevsCache()
+        RevsCache() : data(NULL), loaded(false) {}
+
+        QByteArray* data;      // known records waiting for a DataLoader
+        QStringList dataTips;  // tips of records in data
+        QStringList args;      // loading arguments of current revisions
+        QStringList tips;      // their resolved tips, empty if not cacheable
+        QStringList savedTips; // tips of revisions cache file
+        bool loaded;           // current revisions are complete
+    };
+
+    RevsCache revsCache;
+
     void init2();
     bool run(SCRef cmd, QString* out = NULL, QObject* rcv = NULL, SCRef buf = "");
     bool run(QByteArray* runOutput, SCRef cmd, QObject* rcv = NULL, SCRef buf = "");
@@ -213,44 +251,57 @@ private:
     bool startRevList(SCList args, FileHistory* fh);
     bool startUnappliedList();
     bool startParseProc(SCList initCmd, FileHistory* fh, SCRef buf);
+    bool resolveTips(SCList args, QStringList& tips);
+    bool isRevsCacheValid(SCList cachedTips, SCList tips);
+    void loadRevsCache(QStringList& args);
+    void cacheableRevs(QVector<const Revision*>& v);
+    QByteArray* revsSnapshot();
+    void saveRevsCache();
     bool tryFollowRenames(FileHistory* fh);
     bool populateRenamedPatches(SCRef sha, SCList nn, FileHistory* fh, QStringList* on, bool bt);
     bool filterEarlyOutputRev(FileHistory* fh, Revision* rev);
     int addChunk(FileHistory* fh, const QByteArray& ba, int ofs);
-    void parseDiffFormat(RevFile& rf, SCRef buf, FileNamesLoader& fl);
-    void parseDiffFormatLine(RevFile& rf, SCRef line, int parNum, FileNamesLoader& fl);
+    void addRevision(FileHistory* fh, Revision* rev);
+    void parseDiffFormat(RevFile& rf, const QByteArray& buf, FileNamesLoader& fl);
+    static bool parseDiffFormatLine(RevFile& rf, const char* line, int len, int parNum, PathsVect& paths);
     void getDiffIndex();
     Revision* fakeRevData(SCRef sha, SCList parents, SCRef author, SCRef date, SCRef log,
                          SCRef longLog, SCRef patch, int idx, FileHistory* fh);
     const Revision* fakeWorkDirRev(SCRef parent, SCRef log, SCRef longLog, int idx, FileHistory* fh);
     const RevFile* fakeWorkDirRevFile(const WorkingDirInfo& wd);
     bool copyDiffIndex(FileHistory* fh, SCRef parent);
-    const RevFile* insertNewFiles(SCRef sha, SCRef data);
+    RevFile* parseNewFiles(const QByteArray& data);
     const RevFile* getAllMergeFiles(const Revision* r);
-    bool runDiffTreeWithRenameDetection(SCRef runCmd, QString* runOutput);
+    bool runDiffTreeWithRenameDetection(SCRef runCmd, QByteArray* runOutput);
     bool isParentOf(SCRef par, SCRef child);
     bool isTreeModified(SCRef sha);
-    void indexTree();
-    void updateDescMap(const Revision* r, uint i, QHash<QPair<uint, uint>,bool>& dm,
-                       QHash<uint, QVector<int> >& dv);
-    void mergeNearTags(bool down, Revision* p, const Revision* r, const QHash<QPair<uint, uint>, bool>&dm);
-    void mergeBranches(Revision* p, const Revision* r);
-    void updateLanes(Revision& c, Lanes& lns, SCRef sha);
+    const QVector<int> walkDescendantBranches(const Revision* r);
+    void startTreeIndex();
+    void stopTreeIndex();
+    static void precomputeLanes(FileHistory* fh, const QVector<const Revision*>& revs);
+    static void updateLanes(const Revision& c, Lanes& lns, RevArena* arena);
     bool mkPatchFromWorkDir(SCRef msg, SCRef patchFile, SCList files);
     const QStringList getOthersFiles();
     const QStringList getOtherFiles(SCList selFiles, bool onlyInIndex);
     const QString getNewestFileName(SCList args, SCRef fileName);
     static const QString colorMatch(SCRef txt, QRegExp& regExp);
-    void appendFileName(RevFile& rf, SCRef name, FileNamesLoader& fl);
+    void appendFileName(RevFile& rf, const QByteArray& name, FileNamesLoader& fl);
     void flushFileNames(FileNamesLoader& fl);
+    void mergeFileNames(DiffTreeBatch& batch);
+    void indexRevFile(const ShaString& sha, const RevFile& rf);
+    void indexPaths(int orderIdx, const QByteArray& pathsIdx);
+    void clearPathIndex();
+    void clearLogIndex();
+    bool hasRevFile(const ShaString& sha) const;
+    const RevFile* revFile(const ShaString& sha);
     void populateFileNamesMap();
     const QString formatList(SCList sl, SCRef name, bool inOneLine = true);
     static const QString quote(SCRef nm);
     static const QString quote(SCList sl);
     static const QStringList noSpaceSepHack(SCRef cmd);
     void removeDeleted(SCList selFiles);
-    void setStatus(RevFile& rf, SCRef rowSt);
-    void setExtStatus(RevFile& rf, SCRef rowSt, int parNum, FileNamesLoader& fl);
+    static void setStatus(RevFile& rf, char status);
+    static bool setExtStatus(RevFile& rf, const char* rowSt, int len, int parNum, PathsVect& paths);
     void appendNamesWithId(QStringList& names, SCRef sha, SCList data, bool onlyLoaded);
     Reference* lookupReference(const ShaString& sha, bool create = false);
     EM_DECLARE(exGitStopped);
@@ -258,9 +309,8 @@ private:
     Domain* curDomain;
     QString workDir; // workDir is always without trailing '/'
     QString gitDir;
-    QString filesLoadingPending;
-    QString filesLoadingCurSha;
     int filesLoadingStartOfs;
+    int filesLoadingActive; // running DiffTreeLoader
     bool cacheNeedsUpdate;
     bool errorReportingEnabled;
     bool isMergeHead;
@@ -272,13 +322,24 @@ private:
     int patchesStillToFind;
     QString firstNonStGitPatch;
     RevFileMap revsFiles;
-    QVector<QByteArray> revsFilesShaBackupBuf;
-    QVector<QByteArray> shaBackupBuf;
+    RevFileMap mergeFiles;  // all merge parents files, not cached
+    RevFile* customFiles;   // files of last arbitrary diff, not cached
+    Cache* fileCache;       // revsFiles not yet decoded from file names cache
     StrVect fileNamesVec;
     StrVect dirNamesVec;
-    QHash<QString, int> fileNamesMap; // quick lookup file name
-    QHash<QString, int> dirNamesMap;  // quick lookup directory name
+    QHash<QByteArray, int> fileNamesMap; // quick lookup file name, by raw bytes
+    QHash<QByteArray, int> dirNamesMap;  // quick lookup directory name
+    mutable PathTrie pathTrie;           // full paths, filled on demand
+    QVector<RevBitmap> pathRevs;         // by path node, orderIdx of revisions touching it
+    RevBitmap indexedRevs;               // orderIdx of revisions already in pathRevs
+    TrigramIndex subjectsIndex;          // see getLogFilter()
+    TrigramIndex authorsIndex;
+    TrigramIndex bodiesIndex;
     FileHistory* revData;
+    TreeIndex* treeIndex; // NULL while computing
+    QFutureWatcher<TreeIndex*> treeIndexWatcher;
+    QAtomicInt treeIndexGen; // bumped to cancel a running build
+    QList<PatchSearch*> patchSearches; // running, see startPatchFilter()
     QString m_currentBranch;
 };
 
@@ -274,6 +274,13 @@ static const char* helpInfo =
 "keys to browse them. Toggle the button to remove the highlighting.</p>\n"
 "<p><b>Note:</b> In case of patch content regexp filtering, the given string is\n"
 "interpreted as a POSIX regular expression, not as a simple substring.</p>\n"
+"<p>Select <em>Query</em> to combine more fields, as in\n"
+"<tt>author:marco path:src/net/* after:2024-01-01 msg:/fix(es)?/ -merge</tt>.\n"
+"All the terms must match, a leading '-' negates one. Supported fields\n"
+"are subject, msg, author, sha, path, patch, after and before, dates are\n"
+"written as YYYY-MM-DD. Values are wildcards, or regular expressions when\n"
+"enclosed in slashes. A word with no field is searched in the log header\n"
+"and <em>merge</em> selects merge revisions.</p>\n"
 "<p><b>Tip:</b> Very useful to quick retrieve a sha writing only first 3-4\n"
 "digits and filtering / highlighting on revision sha. The sha value\n"
 "can then be copied from SHA field.</p>\n"
@@ -6,7 +6,6 @@
     Copyright: See COPYING file that comes with this distribution
 
 */
-#include <QStringList>
 #include "common.h"
 #include "lanes.h"
 
@@ -14,7 +13,7 @@
 
 using namespace QGit;
 
-void Lanes::init(const QString& expectedSha)
+void Lanes::init(const ShaString& expectedSha)
 {
     clear();
     activeLane = 0;
@@ -41,7 +40,7 @@ void Lanes::setBoundary(bool b)
         typeVec[activeLane] = LANE_BOUNDARY;
 }
 
-bool Lanes::isFork(const QString& sha, bool& isDiscontinuity)
+bool Lanes::isFork(const ShaString& sha, bool& isDiscontinuity)
 {
     int pos = findNextSha(sha, 0);
     isDiscontinuity = (activeLane != pos);
@@ -61,7 +60,7 @@ bool Lanes::isFork(const QString& sha, bool& isDiscontinuity)
 */
 }
 
-void Lanes::setFork(const QString& sha)
+void Lanes::setFork(const ShaString& sha)
 {
     int rangeStart, rangeEnd, idx;
     rangeStart = rangeEnd = idx = findNextSha(sha, 0);
@@ -100,7 +99,7 @@ void Lanes::setFork(const QString& sha)
     }
 }
 
-void Lanes::setMerge(const QStringList& parents)
+void Lanes::setMerge(const QVector<ShaString>& parents)
 {
 // setFork() must be called before setMerge()
 
@@ -116,10 +115,9 @@ void Lanes::setMerge(const QStringList& parents)
     t = NODE;
 
     int rangeStart = activeLane, rangeEnd = activeLane;
-    QStringList::const_iterator it(parents.constBegin());
-    for (++it; it != parents.constEnd(); ++it) { // skip first parent
+    for (int i = 1; i < parents.count(); i++) { // skip first parent
 
-        int idx = findNextSha(*it, 0);
+        int idx = findNextSha(parents.at(i), 0);
         if (idx != -1) {
 
             if (idx > rangeEnd) {
@@ -136,7 +134,7 @@ void Lanes::setMerge(const QStringList& parents)
 
             typeVec[idx] = LANE_JOIN;
         } else
-            rangeEnd = add(LANE_HEAD, *it, rangeEnd + 1);
+            rangeEnd = add(LANE_HEAD, parents.at(i), rangeEnd + 1);
     }
     LaneType& startT = typeVec[rangeStart];
     LaneType& endT = typeVec[rangeEnd];
@@ -187,7 +185,7 @@ void Lanes::setApplied()
     typeVec[activeLane] = LANE_APPLIED; // TODO test with boundaries
 }
 
-void Lanes::changeActiveLane(const QString& sha)
+void Lanes::changeActiveLane(const ShaString& sha)
 {
     LaneType& t = typeVec[activeLane];
     if (t == LANE_INITIAL || isBoundary(t))
@@ -260,15 +258,17 @@ void Lanes::afterApplied()
     typeVec[activeLane] = LANE_ACTIVE; // TODO test with boundaries
 }
 
-void Lanes::nextParent(const QString& sha)
+void Lanes::nextParent(const ShaString& sha)
 {
-    nextShaVec[activeLane] = (boundary ? "" : sha);
+    nextShaVec[activeLane] = (boundary ? ShaString() : sha);
 }
 
-int Lanes::findNextSha(const QString& next, int pos)
+int Lanes::findNextSha(const ShaString& next, int pos)
 {
+    // a 20 bytes compare, no QString deep compare here
+    const ShaString* v = nextShaVec.constData();
     for (int i = pos; i < nextShaVec.count(); i++)
-        if (nextShaVec[i] == next)
+        if (v[i] == next)
             return i;
     return -1;
 }
@@ -281,7 +281,7 @@ int Lanes::findType(LaneType type, int pos)
     return -1;
 }
 
-int Lanes::add(LaneType type, const QString& next, int pos)
+int Lanes::add(LaneType type, const ShaString& next, int pos)
 {
     // first check empty lanes starting from pos
     if (pos < (int)typeVec.count()) {
@@ -7,9 +7,8 @@
 #ifndef LANES_H
 #define LANES_H
 
-#include <QString>
 #include <QVector>
-#include <QStringList>
+#include "model/shastring.h"
 
 // graph elements
 enum LaneType
@@ -43,9 +42,21 @@ enum LaneType
 
     LANE_TYPES_NUM
 };
+
+// a LaneType stored in one byte, as in Revision::lanes
+class PackedLane
+{
+public:
+    PackedLane(LaneType t) : v((quint8)t) {}
+    operator LaneType() const { return (LaneType)v; }
+
+private:
+    quint8 v;
+};
+Q_DECLARE_TYPEINFO(PackedLane, Q_PRIMITIVE_TYPE);
 //
 //  At any given time, the Lanes class represents a single revision (row) of the history graph.
-//  The Lanes class contains a vector of the sha1 hashes of the next commit to appear in each lane (column).
+//  The Lanes class contains a vector of the sha1 ids of the next commit to appear in each lane (column).
 //  The Lanes class also contains a vector used to decide which glyph to draw on the history graph.
 //
 //  For each revision (row) (from recent (top) to ancient past (bottom)), the Lanes class is updated, and the
@@ -74,31 +85,31 @@ class Lanes
 public:
     Lanes() {} // init() will setup us later, when data is available
     bool isEmpty() { return typeVec.empty(); }
-    void init(const QString& expectedSha);
+    void init(const ShaString& expectedSha);
     void clear();
-    bool isFork(const QString& sha, bool& isDiscontinuity);
+    bool isFork(const ShaString& sha, bool& isDiscontinuity);
     void setBoundary(bool isBoundary);
-    void setFork(const QString& sha);
-    void setMerge(const QStringList& parents);
+    void setFork(const ShaString& sha);
+    void setMerge(const QVector<ShaString>& parents);
     void setInitial();
     void setApplied();
-    void changeActiveLane(const QString& sha);
+    void changeActiveLane(const ShaString& sha);
     void afterMerge();
     void afterFork();
     bool isBranch();
     void afterBranch();
     void afterApplied();
-    void nextParent(const QString &sha);
-    void getLanes(QVector<LaneType> &ln) { ln = typeVec; } // O(1) vector is implicitly shared
+    void nextParent(const ShaString& sha);
+    const QVector<LaneType>& getLanes() const { return typeVec; }
 
 private:
-    int findNextSha(const QString &next, int pos);
+    int findNextSha(const ShaString& next, int pos);
     int findType(LaneType type, int pos);
-    int add(LaneType type, const QString &next, int pos);
+    int add(LaneType type, const ShaString& next, int pos);
 
     int activeLane;
     QVector<LaneType> typeVec;  // Describes which glyphs should be drawn.
-    QVector<QString> nextShaVec;  // The sha1 hashes of the next commit to appear in each lane (column).
+    QVector<ShaString> nextShaVec;  // The sha1 ids of the next commit to appear in each lane (column), null if none.
     bool boundary;
     LaneType NODE, NODE_L, NODE_R;
 };
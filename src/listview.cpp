@@ -54,6 +54,8 @@ void ListView::setup(Domain* dm, Git* g)
 
     connect(this, SIGNAL(diffTargetChanged(int)), lvd, SLOT(diffTargetChanged(int)));
 
+    connect(lp, SIGNAL(filterProgress(int, bool)), this, SIGNAL(filterProgress(int, bool)));
+
     connect(this, SIGNAL(customContextMenuRequested(const QPoint&)),
             this, SLOT(on_customContextMenuRequested(const QPoint&)));
 }
@@ -167,7 +169,7 @@ const QString ListView::currentText(int column)
 LaneType ListView::getLaneType(SCRef sha, int pos) const
 {
     const Revision* r = git->revLookup(sha, fh);
-    return (r && pos < r->lanes.count() && pos >= 0 ? r->lanes.at(pos) : LANE_UNDEFINED);
+    return (r && pos < r->lanes.count() && pos >= 0 ? LaneType(r->lanes.at(pos)) : LANE_UNDEFINED);
 }
 
 void ListView::showIdValues()
@@ -196,16 +198,25 @@ const QString ListView::shaFromAnnId(uint id)
     return sha(model()->rowCount() - id);
 }
 
-int ListView::filterRows(bool isOn, bool highlight, SCRef filter, int colNum, ShaSet* set)
+int ListView::filterRows(bool isOn, bool highlight, SCRef filter, int colNum, ShaSet* set, int setRows)
 {
     setUpdatesEnabled(false);
-    int matchedNum = lp->setFilter(isOn, highlight, filter, colNum, set);
+    int matchedNum = lp->setFilter(isOn, highlight, filter, colNum, set, setRows);
     viewport()->update();
     setUpdatesEnabled(true);
     UPDATE_DOMAIN(d);
     return matchedNum;
 }
 
+int ListView::addFilterMatches(SCList shas)
+{
+    setUpdatesEnabled(false);
+    int matchedNum = lp->addMatches(shas);
+    viewport()->update();
+    setUpdatesEnabled(true);
+    return matchedNum;
+}
+
 bool ListView::update()
 {
     int stRow = row(st->sha());
@@ -34,7 +34,8 @@ public:
     bool update();
     void addNewRevs(const QVector<QString>& shaVec);
     const QString currentText(int col);
-    int filterRows(bool, bool, SCRef = QString(), int = -1, ShaSet* = NULL);
+    int filterRows(bool, bool, SCRef = QString(), int = -1, ShaSet* = NULL, int = 0);
+    int addFilterMatches(SCList shas);
     const QString sha(int row) const;
     int row(SCRef sha) const;
 
@@ -44,6 +45,7 @@ signals:
     void revisionsDropped(const QStringList&);
     void contextMenu(const QString&, int);
     void diffTargetChanged(int); // used by new model_view integration
+    void filterProgress(int, bool);
 
 public slots:
     void on_changeFont(const QFont& f);
@@ -35,6 +35,8 @@ const Revision* ListViewDelegate::revLookup(int row, FileHistory** fhPtr) const
     return git->revLookup(lv->sha(row), fh);
 }
 
+#define GLYPH_EXTRA_WIDTH 8 // lane padding + pen overflow, see paintGraphLane()
+
 static QColor blend(const QColor& col1, const QColor& col2, int amount = 128) {
 
     // Returns ((256 - amount)*col1 + amount*col2) / 256;
@@ -231,6 +233,33 @@ void ListViewDelegate::paintGraphLane(QPainter* p, int type, int x1, int x2,
     #undef PADDING
 }
 
+const QPixmap& ListViewDelegate::laneGlyph(int type, const QColor& col,
+                                           const QColor& activeCol, const QBrush& back) const
+{
+/*
+   Painting a lane involves gradients, arcs and antialiasing, so each glyph
+   is rendered once on a transparent pixmap and then just blitted. Glyphs
+   depend only on arguments and on lane height, when this changes the atlas
+   is cleared. Pixmap includes lane padding and pen overflow on both sides.
+*/
+    QPair<quint64, quint64> key(((quint64)type << 32) | col.rgb(),
+                                ((quint64)activeCol.rgb() << 32) | back.color().rgb());
+
+    QHash<QPair<quint64, quint64>, QPixmap>::const_iterator it(glyphAtlas.constFind(key));
+    if (it != glyphAtlas.constEnd())
+        return *it;
+
+    QPixmap pm(laneWidth() + GLYPH_EXTRA_WIDTH, laneHeight);
+    pm.fill(Qt::transparent);
+
+    QPainter gp(&pm);
+    gp.setRenderHints(QPainter::Antialiasing);
+    paintGraphLane(&gp, type, 0, laneWidth(), col, activeCol, back);
+    gp.end();
+
+    return *glyphAtlas.insert(key, pm);
+}
+
 void ListViewDelegate::paintGraph(QPainter* p, const QStyleOptionViewItem& opt,
                                   const QModelIndex& i) const {
 
@@ -258,7 +287,7 @@ void ListViewDelegate::paintGraph(QPainter* p, const QStyleOptionViewItem& opt,
         git->setLane(r->sha(), fh);
 
     QBrush back = opt.palette.base();
-    const QVector<LaneType>& lanes(r->lanes);
+    const ArenaVector<PackedLane>& lanes(r->lanes);
     uint laneNum = lanes.count();
     uint activeLane = 0;
     for (uint i = 0; i < laneNum; i++)
@@ -283,7 +312,7 @@ void ListViewDelegate::paintGraph(QPainter* p, const QStyleOptionViewItem& opt,
             continue;
 
         QColor color = i == activeLane ? activeColor : colors[i % COLORS_NUM];
-        paintGraphLane(p, ln, x1, x2, color, activeColor, back);
+        p->drawPixmap(x1, 0, laneGlyph(ln, color, activeColor, back));
     }
     p->restore();
 }
@@ -2,6 +2,9 @@
 #define LISTVIEWDELEGATE_H
 
 #include <QItemDelegate>
+#include <QHash>
+#include <QPair>
+#include <QPixmap>
 #include "git.h"
 #include "listviewproxy.h"
 #include <QPainter>
@@ -17,7 +20,7 @@ public:
     virtual void paint(QPainter* p, const QStyleOptionViewItem& o, const QModelIndex &i) const;
     virtual QSize sizeHint(const QStyleOptionViewItem& o, const QModelIndex &i) const;
     int laneWidth() const { return 3 * laneHeight / 4; }
-    void setLaneHeight(int h) { laneHeight = h; }
+    void setLaneHeight(int h) { laneHeight = h; glyphAtlas.clear(); } // glyphs depend on height
 
 signals:
     void updateView();
@@ -31,6 +34,8 @@ private:
     void paintGraph(QPainter* p, const QStyleOptionViewItem& o, const QModelIndex &i) const;
     void paintGraphLane(QPainter* p, int type, int x1, int x2, const QColor& col,
                         const QColor& activeCol, const QBrush& back) const;
+    const QPixmap& laneGlyph(int type, const QColor& col, const QColor& activeCol,
+                             const QBrush& back) const;
     QPixmap* getTagMarks(SCRef sha, const QStyleOptionViewItem& opt) const;
     void addRefPixmap(QPixmap** pp, SCRef sha, int type, QStyleOptionViewItem opt) const;
     void addTextPixmap(QPixmap** pp, SCRef txt, const QStyleOptionViewItem& opt) const;
@@ -40,6 +45,7 @@ private:
     ListViewProxy* lp;
     int laneHeight;
     int diffTargetRow;
+    mutable QHash<QPair<quint64, quint64>, QPixmap> glyphAtlas; // see laneGlyph()
 };
 
 #endif // LISTVIEWDELEGATE_H
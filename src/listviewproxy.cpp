@@ -1,14 +1,19 @@
+#include <QTime>
 #include "listviewproxy.h"
 
+#define FILTER_SLICE_MS 20 // max time matching rows before back to event loop
+
 using   namespace QGit;
 
-ListViewProxy::ListViewProxy(QObject* p, Domain * dm, Git * g) : QSortFilterProxyModel(p) {
+ListViewProxy::ListViewProxy(QObject* p, Domain * dm, Git * g) : QAbstractProxyModel(p) {
 
     d = dm;
     git = g;
     colNum = 0;
+    setRows = 0;
+    nextRow = 0;
     isHighLight = false;
-    setDynamicSortFilter(false);
+    connect(&scanTimer, SIGNAL(timeout()), this, SLOT(scanRows()));
 }
 
 bool ListViewProxy::isMatch(SCRef sha) const {
@@ -42,6 +47,9 @@ bool ListViewProxy::isMatch(int source_row) const {
     if (fh->rowCount() <= source_row) // FIXME required to avoid an ASSERT in d->isMatch()
         return false;
 
+    if (source_row < setRows) // already narrowed by an index, see Git::getLogFilter()
+        return shaSet.contains(fh->sha(source_row));
+
     bool extFilter = (colNum == -1);
     return ((!extFilter && isMatch(fh->sha(source_row)))
           ||( extFilter && d->isMatch(fh->sha(source_row))));
@@ -54,15 +62,11 @@ bool ListViewProxy::isHighlighted(int row) const {
     return (isHighLight && isMatch(row));
 }
 
-bool ListViewProxy::filterAcceptsRow(int source_row, const QModelIndex&) const {
-
-    return (isHighLight || isMatch(source_row));
-}
-
-int ListViewProxy::setFilter(bool isOn, bool h, SCRef fl, int cn, ShaSet* s) {
+int ListViewProxy::setFilter(bool isOn, bool h, SCRef fl, int cn, ShaSet* s, int sr) {
 
     filter = QRegExp(fl, Qt::CaseInsensitive, QRegExp::Wildcard);
     colNum = cn;
+    setRows = (s ? sr : 0);
     if (s)
         shaSet = *s;
 
@@ -70,7 +74,7 @@ int ListViewProxy::setFilter(bool isOn, bool h, SCRef fl, int cn, ShaSet* s) {
     // so reset 'isHighLight' flag in that case
     isHighLight = h && isOn;
 
-    ListView* lv = static_cast<ListView*>(parent());
+    ListView* lv = static_cast<ListView*>(QObject::parent());
     FileHistory* fh = d->model();
 
     if (!isOn && sourceModel()){
@@ -78,8 +82,174 @@ int ListViewProxy::setFilter(bool isOn, bool h, SCRef fl, int cn, ShaSet* s) {
         setSourceModel(NULL);
 
     } else if (isOn && !isHighLight) {
-        setSourceModel(fh); // trigger a rows scanning
+        setSourceModel(fh); // aborts any running scan and starts a new one
         lv->setModel(this);
     }
     return (sourceModel() ? rowCount() : 0);
 }
+
+int ListViewProxy::addMatches(SCList shas) {
+
+    // partial results of a running search, shaSet only grows
+    FOREACH_SL (it, shas)
+        shaSet.insert(*it);
+
+    if (!sourceModel())
+        return 0;
+
+    // rows not yet scanned will be checked against the new
+    // set, already scanned ones are merged here in order
+    FileHistory* fh = d->model();
+    QVector<int> newRows;
+    FOREACH_SL (it, shas) {
+        int row = fh->row(*it);
+        if (   row != -1 && row < nextRow
+            && qBinaryFind(rows.constBegin(), rows.constEnd(), row) == rows.constEnd())
+            newRows.append(row);
+    }
+    if (newRows.isEmpty())
+        return rows.count();
+
+    qSort(newRows);
+    emit layoutAboutToBeChanged();
+
+    const QModelIndexList oldIdx(persistentIndexList());
+    QVector<int> srcRows;
+    FOREACH (QModelIndexList, it, oldIdx)
+        srcRows.append(rows.at((*it).row()));
+
+    QVector<int> merged;
+    merged.reserve(rows.count() + newRows.count());
+    int i = 0, j = 0;
+    while (i < rows.count() || j < newRows.count()) {
+        if (j == newRows.count() || (i < rows.count() && rows.at(i) < newRows.at(j)))
+            merged.append(rows.at(i++));
+        else
+            merged.append(newRows.at(j++));
+    }
+    rows = merged;
+
+    QModelIndexList newIdx;
+    for (int k = 0; k < oldIdx.count(); k++)
+        newIdx.append(mapFromSource(fh->index(srcRows.at(k), oldIdx.at(k).column())));
+
+    changePersistentIndexList(oldIdx, newIdx);
+    emit layoutChanged();
+    return rows.count();
+}
+
+void ListViewProxy::setSourceModel(QAbstractItemModel* sm) {
+
+    if (sourceModel())
+        disconnect(sourceModel(), 0, this, 0);
+
+    QAbstractProxyModel::setSourceModel(sm);
+
+    if (sm) {
+        connect(sm, SIGNAL(rowsInserted(const QModelIndex&, int, int)),
+                this, SLOT(on_sourceRowsInserted(const QModelIndex&, int, int)));
+
+        connect(sm, SIGNAL(modelReset()), this, SLOT(restartScan()));
+    }
+    restartScan();
+}
+
+void ListViewProxy::restartScan() {
+
+    scanTimer.stop();
+    rows.clear();
+    nextRow = 0;
+    reset();
+    if (sourceModel())
+        scanRows(); // first slice at once, small histories are done here
+}
+
+void ListViewProxy::on_sourceRowsInserted(const QModelIndex&, int, int) {
+
+    // new revisions loaded while filtering, resume scanning
+    if (!scanTimer.isActive())
+        scanRows();
+}
+
+void ListViewProxy::scanRows() {
+/*
+   Match rows until time slice is over, then publish the accepted ones
+   and get back to the event loop. Scanning goes on from nextRow at
+   next timer shot, until all the rows are checked.
+*/
+    const int cnt = d->model()->rowCount();
+    QVector<int> found;
+    QTime t;
+    t.start();
+    while (nextRow < cnt && t.elapsed() < FILTER_SLICE_MS)
+        for (int end = qMin(nextRow + 256, cnt); nextRow < end; nextRow++)
+            if (isMatch(nextRow))
+                found.append(nextRow);
+
+    if (!found.isEmpty()) {
+        beginInsertRows(QModelIndex(), rows.count(), rows.count() + found.count() - 1);
+        rows << found;
+        endInsertRows();
+    }
+    bool done = (nextRow >= cnt);
+    if (done)
+        scanTimer.stop();
+    else if (!scanTimer.isActive())
+        scanTimer.start(0);
+
+    emit filterProgress(rows.count(), done);
+}
+
+QModelIndex ListViewProxy::mapFromSource(const QModelIndex& src) const {
+
+    if (!src.isValid())
+        return QModelIndex();
+
+    QVector<int>::const_iterator it(qBinaryFind(rows.constBegin(), rows.constEnd(), src.row()));
+    if (it == rows.constEnd())
+        return QModelIndex();
+
+    return index(it - rows.constBegin(), src.column());
+}
+
+QModelIndex ListViewProxy::mapToSource(const QModelIndex& proxy) const {
+
+    if (!proxy.isValid() || !sourceModel() || proxy.row() >= rows.count())
+        return QModelIndex();
+
+    return sourceModel()->index(rows.at(proxy.row()), proxy.column());
+}
+
+QModelIndex ListViewProxy::index(int row, int column, const QModelIndex& par) const {
+
+    if (par.isValid() || row < 0 || row >= rows.count() || column < 0 || column >= columnCount())
+        return QModelIndex();
+
+    return createIndex(row, column);
+}
+
+QModelIndex ListViewProxy::parent(const QModelIndex&) const {
+
+    return QModelIndex(); // a flat list
+}
+
+int ListViewProxy::rowCount(const QModelIndex& par) const {
+
+    return (par.isValid() ? 0 : rows.count());
+}
+
+int ListViewProxy::columnCount(const QModelIndex&) const {
+
+    return (sourceModel() ? sourceModel()->columnCount() : 0);
+}
+
+Qt::ItemFlags ListViewProxy::flags(const QModelIndex& index) const {
+
+    return (sourceModel() ? sourceModel()->flags(mapToSource(index)) : Qt::ItemFlags(0));
+}
+
+QVariant ListViewProxy::headerData(int s, Qt::Orientation o, int role) const {
+
+    // columns are the same of the source, also with no rows
+    return (sourceModel() ? sourceModel()->headerData(s, o, role) : QVariant());
+}
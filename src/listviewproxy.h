@@ -1,7 +1,8 @@
 #ifndef LISTVIEWPROXY_H
 #define LISTVIEWPROXY_H
 
-#include <QSortFilterProxyModel>
+#include <QAbstractProxyModel>
+#include <QTimer>
 #include "common.h"
 #include "filehistory.h"
 #include "listview.h"
@@ -10,16 +11,38 @@ class Git;
 class StateInfo;
 class Domain;
 
-class ListViewProxy : public QSortFilterProxyModel
+/*
+   Filtered rows of a FileHistory. Rows are matched in short time slices
+   from the event loop, and accepted ones are appended as they are found,
+   so the GUI stays responsive also with a huge history. A new filter
+   aborts the running scan and starts from scratch.
+*/
+class ListViewProxy : public QAbstractProxyModel
 {
     Q_OBJECT
 public:
     ListViewProxy(QObject* parent, Domain* d, Git* g);
-    int setFilter(bool isOn, bool highlight, SCRef filter, int colNum, ShaSet* s);
+    int setFilter(bool isOn, bool highlight, SCRef filter, int colNum, ShaSet* s, int setRows);
+    int addMatches(SCList shas);
     bool isHighlighted(int row) const;
 
-protected:
-    virtual bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const;
+    virtual void setSourceModel(QAbstractItemModel* sm);
+    virtual QModelIndex mapFromSource(const QModelIndex& src) const;
+    virtual QModelIndex mapToSource(const QModelIndex& proxy) const;
+    virtual QModelIndex index(int row, int column, const QModelIndex& par = QModelIndex()) const;
+    virtual QModelIndex parent(const QModelIndex& index) const;
+    virtual int rowCount(const QModelIndex& par = QModelIndex()) const;
+    virtual int columnCount(const QModelIndex& par = QModelIndex()) const;
+    virtual Qt::ItemFlags flags(const QModelIndex& index) const;
+    virtual QVariant headerData(int s, Qt::Orientation o, int role = Qt::DisplayRole) const;
+
+signals:
+    void filterProgress(int matched, bool done);
+
+private slots:
+    void scanRows();
+    void restartScan();
+    void on_sourceRowsInserted(const QModelIndex&, int, int);
 
 private:
     bool isMatch(int row) const;
@@ -31,6 +54,10 @@ private:
     QRegExp filter;
     int colNum;
     ShaSet shaSet;
+    int setRows;       // rows below are matched only against shaSet
+    QVector<int> rows; // accepted source rows, in ascending order
+    int nextRow;       // first source row not yet scanned
+    QTimer scanTimer;
 };
 
 #endif // LISTVIEWPROXY_H
@@ -0,0 +1,183 @@
+/*
+    Description: LZ4 block format codec
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#include <string.h> // used by memcpy()
+#include <QtGlobal>
+#include "lz4codec.h"
+
+#define MIN_MATCH     4
+#define MAX_OFFSET    65535
+#define LAST_LITERALS 5  // format requires the block to end with literals...
+#define MF_LIMIT      12 // ...and the last match to start before this
+#define HASH_LOG      14
+#define SKIP_TRIGGER  6  // step up search after 2^6 misses, incompressible data
+
+static inline quint32 read32(const uchar* p) {
+
+    quint32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline int hash(quint32 seq) {
+
+    return int((seq * 2654435761U) >> (32 - HASH_LOG));
+}
+
+static inline uchar* putLength(uchar* op, int len) {
+
+    for ( ; len >= 255; len -= 255)
+        *op++ = 255;
+
+    *op++ = uchar(len);
+    return op;
+}
+
+static inline bool getLength(const uchar*& ip, const uchar* end, int max, int& len) {
+
+    uint b;
+    do {
+        if (ip == end || len > max)
+            return false;
+
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+
+    return true;
+}
+
+static uchar* putSequence(uchar* op, const uchar* lit, int litLen, int offset, int matchLen) {
+
+    // matchLen is already reduced by MIN_MATCH, -1 for the last literals only
+    uchar* token = op++;
+    *token = uchar(qMin(litLen, 15) << 4);
+    if (litLen >= 15)
+        op = putLength(op, litLen - 15);
+
+    memcpy(op, lit, litLen);
+    op += litLen;
+
+    if (matchLen < 0)
+        return op;
+
+    *op++ = uchar(offset);
+    *op++ = uchar(offset >> 8);
+    *token |= uchar(qMin(matchLen, 15));
+    if (matchLen >= 15)
+        op = putLength(op, matchLen - 15);
+
+    return op;
+}
+
+int Lz4::maxCompressedSize(int size) {
+
+    return size + size / 255 + 16;
+}
+
+int Lz4::compress(const char* src, int size, char* dst) {
+
+    const uchar* base = (const uchar*)src;
+    const uchar* end = base + size;
+    const uchar* ip = base;
+    const uchar* anchor = base; // start of pending literals
+    uchar* op = (uchar*)dst;
+
+    if (size > MF_LIMIT) {
+
+        const uchar* mfLimit = end - MF_LIMIT;
+        const uchar* matchLimit = end - LAST_LITERALS;
+        int table[1 << HASH_LOG]; // last position of each hashed sequence
+        memset(table, -1, sizeof(table));
+        int misses = 1 << SKIP_TRIGGER;
+
+        while (ip < mfLimit) {
+
+            const quint32 seq = read32(ip);
+            const int h = hash(seq);
+            const int refPos = table[h];
+            table[h] = int(ip - base);
+
+            if (   refPos < 0
+                || ip - (base + refPos) > MAX_OFFSET
+                || read32(base + refPos) != seq) {
+
+                ip += misses++ >> SKIP_TRIGGER;
+                continue;
+            }
+            misses = 1 << SKIP_TRIGGER;
+            const uchar* ref = base + refPos;
+
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const uchar* mEnd = ip + MIN_MATCH;
+            const uchar* rEnd = ref + MIN_MATCH;
+            while (mEnd < matchLimit && *mEnd == *rEnd) {
+                mEnd++;
+                rEnd++;
+            }
+            op = putSequence(op, anchor, int(ip - anchor), int(ip - ref), int(mEnd - ip) - MIN_MATCH);
+            ip = anchor = mEnd;
+        }
+    }
+    op = putSequence(op, anchor, int(end - anchor), 0, -1);
+    return int(op - (uchar*)dst);
+}
+
+bool Lz4::decompress(const char* src, int srcSize, char* dst, int dstSize) {
+
+    const uchar* ip = (const uchar*)src;
+    const uchar* end = ip + srcSize;
+    uchar* op = (uchar*)dst;
+    uchar* const oBegin = op;
+    uchar* const oEnd = op + dstSize;
+
+    while (ip < end) {
+
+        const uint token = *ip++;
+        int litLen = token >> 4;
+        if (litLen == 15 && !getLength(ip, end, dstSize, litLen))
+            return false;
+
+        if (litLen > end - ip || litLen > oEnd - op)
+            return false;
+
+        memcpy(op, ip, litLen);
+        ip += litLen;
+        op += litLen;
+
+        if (ip == end) // last sequence has no match
+            break;
+
+        if (end - ip < 2)
+            return false;
+
+        const int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - oBegin)
+            return false;
+
+        int matchLen = token & 15;
+        if (matchLen == 15 && !getLength(ip, end, dstSize, matchLen))
+            return false;
+
+        matchLen += MIN_MATCH;
+        if (matchLen > oEnd - op)
+            return false;
+
+        const uchar* ref = op - offset;
+        if (offset >= matchLen)
+            memcpy(op, ref, matchLen);
+        else
+            for (int i = 0; i < matchLen; i++) // overlapping, repeats last bytes
+                op[i] = ref[i];
+
+        op += matchLen;
+    }
+    return (op == oEnd);
+}
@@ -0,0 +1,31 @@
+/*
+    Description: LZ4 block format codec
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#ifndef LZ4CODEC_H
+#define LZ4CODEC_H
+
+/*
+   A small compressor and decompressor for the LZ4 block format, that
+   is the content of a single LZ4 frame block, without frame headers
+   and checksums. It trades ratio for speed: text as 'git log' output
+   is packed about three times and unpacked at memory bandwidth.
+
+   Functions are reentrant and can be called by worker threads.
+*/
+namespace Lz4 {
+
+    int maxCompressedSize(int size);
+
+    // returns the compressed size, 'dst' must be at
+    // least maxCompressedSize(size) bytes long
+    int compress(const char* src, int size, char* dst);
+
+    // false if 'src' is corrupted or does not unpack
+    // to exactly 'dstSize' bytes, never writes past it
+    bool decompress(const char* src, int srcSize, char* dst, int dstSize);
+}
+
+#endif
@@ -59,7 +59,7 @@ MainImpl::MainImpl(SCRef cd, QWidget *parent) : QMainWindow(parent)
     QAction* act = toolBar->insertWidget(ActSearchAndFilter, lineEditFilter);
 
     cmbSearch = new QComboBox(NULL);
-    QString list("Short log,Log msg,Author,SHA1,File,Patch,Patch (regExp)");
+    QString list("Short log,Log msg,Author,SHA1,File,Patch,Patch (regExp),Query");
     cmbSearch->addItems(list.split(","));
 
     toolBar->insertWidget(act, cmbSearch);
@@ -79,6 +79,9 @@ MainImpl::MainImpl(SCRef cd, QWidget *parent) : QMainWindow(parent)
 
     // init native types
     setRepositoryBusy = false;
+    patchMatchedCnt = 0;
+    patchFlushPending = false;
+    patchSearching = false;
 
     // init filter match highlighters
     shortLogRE.setMinimal(true);
@@ -145,6 +148,11 @@ MainImpl::MainImpl(SCRef cd, QWidget *parent) : QMainWindow(parent)
 
     connect(git, SIGNAL(fileNamesLoad(int, int)), this, SLOT(fileNamesLoad(int, int)));
 
+    connect(git, SIGNAL(patchFilterFound(const QStringList&)),
+            this, SLOT(patchFilterFound(const QStringList&)));
+
+    connect(git, SIGNAL(patchFilterDone()), this, SLOT(patchFilterDone()));
+
     connect(git, SIGNAL(newRevsAdded(const FileHistory*, const QVector<ShaString>&)),
             this, SLOT(newRevsAdded(const FileHistory*, const QVector<ShaString>&)));
 
@@ -156,6 +164,9 @@ MainImpl::MainImpl(SCRef cd, QWidget *parent) : QMainWindow(parent)
     connect(rv->tab()->listViewLog, SIGNAL(doubleClicked(const QModelIndex&)),
             this, SLOT(listViewLog_doubleClicked(const QModelIndex&)));
 
+    connect(rv->tab()->listViewLog, SIGNAL(filterProgress(int, bool)),
+            this, SLOT(filterProgress(int, bool)));
+
     connect(rv->tab()->fileList, SIGNAL(itemDoubleClicked(QListWidgetItem*)),
             this, SLOT(fileList_itemDoubleClicked(QListWidgetItem*)));
 
@@ -595,8 +606,9 @@ void MainImpl::ActViewDiff_activated()
     ActViewDiffNewTab->setEnabled(true);
 
     if (ActSearchAndFilter->isChecked() || ActSearchAndHighlight->isChecked()) {
-        bool isRegExp = (cmbSearch->currentIndex() == CS_PATCH_REGEXP);
-        emit highlightPatch(lineEditFilter->text(), isRegExp);
+        bool isRegExp;
+        const QString exp(patchFilterExp(&isRegExp));
+        emit highlightPatch(exp, isRegExp);
     }
 }
 
@@ -765,9 +777,9 @@ void MainImpl::filterList(bool isOn, bool onlyHighlight)
         return;
 
     ShaSet shaSet;
-    bool patchNeedsUpdate, isRegExp;
-    patchNeedsUpdate = isRegExp = false;
-    int idx = cmbSearch->currentIndex(), colNum = 0;
+    bool patchNeedsUpdate, isRegExp, isPatchSearch;
+    patchNeedsUpdate = isRegExp = isPatchSearch = false;
+    int idx = cmbSearch->currentIndex(), colNum = 0, setRows = 0;
 
     if (isOn) {
         switch (idx) {
@@ -788,37 +800,74 @@ void MainImpl::filterList(bool isOn, bool onlyHighlight)
         case CS_FILE:
         case CS_PATCH:
         case CS_PATCH_REGEXP:
+        case CS_QUERY: {
             colNum = SHA_MAP_COL;
             QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
             EM_PROCESS_EVENTS; // to paint wait cursor
 
+            QString patchExp;
+            ShaSet patchRevs;
+            const ShaSet* limit = NULL;
             if (idx == CS_FILE) {
                 git->getFileFilter(filter, shaSet);
+
+            } else if (idx == CS_QUERY) {
+                RevQuery q;
+                if (!q.compile(filter)) {
+                    QApplication::restoreOverrideCursor();
+                    (onlyHighlight ? ActSearchAndHighlight : ActSearchAndFilter)->toggle();
+                    QApplication::postEvent(rv, new MessageEvent(q.errorString()));
+                    return;
+                }
+                git->getQueryFilter(q, shaSet);
+
+                // patch term is the most expensive, only on query matches
+                const RevQuery::Term* pt = q.patchTerm();
+                if (pt && !shaSet.isEmpty()) {
+                    patchExp = pt->value;
+                    isRegExp = pt->isRegExp;
+                    patchRevs = shaSet;
+                    limit = &patchRevs;
+                    shaSet.clear();
+                }
             } else {
+                patchExp = filter;
                 isRegExp = (idx == CS_PATCH_REGEXP);
+            }
+            if (!patchExp.isEmpty()) {
+                // matches arrive later, see patchFilterFound()
+                patchMatches.clear();
+                patchMatchedCnt = 0;
 
-                if (!git->getPatchFilter(filter, isRegExp, shaSet)) {
+                if (!git->startPatchFilter(patchExp, isRegExp, limit)) {
                     QApplication::restoreOverrideCursor();
                     ActSearchAndFilter->toggle();
                     return;
                 }
-
-                patchNeedsUpdate = (shaSet.count() > 0);
+                isPatchSearch = patchSearching = true;
             }
-
             QApplication::restoreOverrideCursor();
             break;
         }
+        }
+        // narrow matching of the rows loaded so far with an index, these
+        // are then filtered by sha, the ones still loading as usual
+        if (colNum == LOG_COL || colNum == LOG_MSG_COL || colNum == AUTH_COL)
+            setRows = git->getLogFilter(filter, colNum, shaSet);
     } else {
-        patchNeedsUpdate = (idx == CS_PATCH || idx == CS_PATCH_REGEXP);
+        git->stopPatchFilter();
+        patchMatches.clear();
+        patchSearching = false;
+        patchNeedsUpdate = (idx == CS_PATCH || idx == CS_PATCH_REGEXP || idx == CS_QUERY);
         shortLogRE.setPattern("");
         longLogRE.setPattern("");
     }
 
     QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 
+    // rows are matched in background, see filterProgress()
     ListView* lv = rv->tab()->listViewLog;
-    int matchedCnt = lv->filterRows(isOn, onlyHighlight, filter, colNum, &shaSet);
+    lv->filterRows(isOn, onlyHighlight, filter, colNum, &shaSet, setRows);
 
     QApplication::restoreOverrideCursor();
 
@@ -827,13 +876,84 @@ void MainImpl::filterList(bool isOn, bool onlyHighlight)
     if (patchNeedsUpdate)
         emit highlightPatch(isOn ? filter : "", isRegExp);
 
+    if (isPatchSearch)
+        QApplication::postEvent(rv, new MessageEvent("Searching patches..."));
+
+    else if (!isOn || onlyHighlight)
+        QApplication::postEvent(rv, new MessageEvent("")); // deferred message, after update
+}
+
+const QString MainImpl::patchFilterExp(bool* isRegExp)
+{
+    // in a query only the patch term, if any, is highlighted
+    int idx = cmbSearch->currentIndex();
+    *isRegExp = (idx == CS_PATCH_REGEXP);
+    if (idx != CS_QUERY)
+        return lineEditFilter->text();
+
+    RevQuery q;
+    const RevQuery::Term* pt = (q.compile(lineEditFilter->text()) ? q.patchTerm() : NULL);
+    *isRegExp = (pt && pt->isRegExp);
+    return (pt ? pt->value : "");
+}
+
+void MainImpl::filterProgress(int matched, bool done)
+{
+    if (patchSearching) // has its own messages
+        return;
+
     QString msg;
+    if (done)
+        msg = QString("Found %1 matches. Toggle filter/highlight "
+                      "button to remove the filter").arg(matched);
+    else
+        msg = QString("Filtering, %1 matches found so far...").arg(matched);
 
-    if (isOn && !onlyHighlight)
+    QApplication::postEvent(rv, new MessageEvent(msg));
+}
+
+void MainImpl::patchFilterFound(const QStringList& shas)
+{
+    // rows are rescanned at each update, so batch them
+    patchMatches << shas;
+    if (!patchFlushPending) {
+        patchFlushPending = true;
+        QTimer::singleShot(300, this, SLOT(flushPatchMatches()));
+    }
+}
+
+void MainImpl::flushPatchMatches()
+{
+    patchFlushPending = false;
+    if (patchMatches.isEmpty())
+        return;
+
+    rv->tab()->listViewLog->addFilterMatches(patchMatches);
+    patchMatchedCnt += patchMatches.count();
+    patchMatches.clear();
+
+    QString msg("Searching patches, %1 matches found so far...");
+    QApplication::postEvent(rv, new MessageEvent(msg.arg(patchMatchedCnt)));
+}
+
+void MainImpl::patchFilterDone()
+{
+    patchSearching = false;
+    flushPatchMatches();
+    emit updateRevDesc(); // could be highlighted
+
+    if (patchMatchedCnt > 0) {
+        bool isRegExp;
+        const QString exp(patchFilterExp(&isRegExp));
+        emit highlightPatch(exp, isRegExp);
+    }
+
+    QString msg;
+    if (!ActSearchAndHighlight->isChecked())
         msg = QString("Found %1 matches. Toggle filter/highlight "
-                      "button to remove the filter").arg(matchedCnt);
+                      "button to remove the filter").arg(patchMatchedCnt);
 
-    QApplication::postEvent(rv, new MessageEvent(msg)); // deferred message, after update
+    QApplication::postEvent(rv, new MessageEvent(msg));
 }
 
 bool MainImpl::event(QEvent* e)
@@ -52,7 +52,8 @@ public:
         CS_SHA1,
         CS_FILE,
         CS_PATCH,
-        CS_PATCH_REGEXP
+        CS_PATCH_REGEXP,
+        CS_QUERY
     };
 
     QComboBox *cmbSearch;
@@ -73,6 +74,10 @@ private slots:
     void tabWdg_currentChanged(int);
     void newRevsAdded(const FileHistory*, const QVector<ShaString>&);
     void fileNamesLoad(int, int);
+    void patchFilterFound(const QStringList&);
+    void patchFilterDone();
+    void flushPatchMatches();
+    void filterProgress(int, bool);
     void revisionsDragged(const QStringList&);
     void revisionsDropped(const QStringList&);
     void shortCutActivated();
@@ -144,6 +149,7 @@ private:
     int currentTabType(Domain** t);
     void filterList(bool isOn, bool onlyHighlight);
     bool isMatch(SCRef sha, SCRef f, int cn, const QMap<QString,bool>& sm);
+    const QString patchFilterExp(bool* isRegExp);
     void highlightAbbrevSha(SCRef abbrevSha);
     void setRepository(SCRef wd, bool = false, bool = false, const QStringList* = NULL, bool = false);
     void getExternalDiffArgs(QStringList* args, QStringList* filenames);
@@ -185,6 +191,10 @@ private:
     QString textToFind;
     QRegExp shortLogRE;
     QRegExp longLogRE;
+    QStringList patchMatches; // found but not yet shown
+    int patchMatchedCnt;
+    bool patchFlushPending;
+    bool patchSearching; // status bar is updated by patch search
     bool setRepositoryBusy;
 };
 
@@ -0,0 +1,76 @@
+#include <QtAlgorithms>
+#include "bytescan.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCAN_SSE2
+#endif
+
+#if defined(SCAN_AVX2) || defined(SCAN_SSE2)
+#ifdef _MSC_VER
+#include <intrin.h>
+static inline int lowestBit(uint m) { unsigned long b; _BitScanForward(&b, m); return int(b); }
+#else
+static inline int lowestBit(uint m) { return __builtin_ctz(m); }
+#endif
+
+static inline void addMarks(QVector<uint>& v, int base, uint any, uint nul) {
+
+    // 'any' has a bit set for each '\n' or '\0' of the chunk at 'base'
+    while (any) {
+        int b = lowestBit(any);
+        v.append((uint(base + b) << 1) | ((nul >> b) & 1));
+        any &= any - 1;
+    }
+}
+#endif
+
+void ByteMarks::scan(const char* data, int from, int to)
+{
+    marks.clear();
+    marks.reserve((to - from) / 32); // log lines are a bit longer
+    const uchar* p = (const uchar*)data;
+    int i = from;
+
+#if defined(SCAN_AVX2)
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    for ( ; i + 32 <= to; i += 32) {
+
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        uint nul = uint(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)));
+        uint any = uint(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl))) | nul;
+        if (any)
+            addMarks(marks, i, any, nul);
+    }
+#elif defined(SCAN_SSE2)
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; i + 16 <= to; i += 16) {
+
+        const __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        uint nul = uint(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)));
+        uint any = uint(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl))) | nul;
+        if (any)
+            addMarks(marks, i, any, nul);
+    }
+#endif
+    // scalar tail, or the whole block without SIMD
+    for ( ; i < to; i++)
+        if (p[i] == '\n' || p[i] == '\0')
+            marks.append((uint(i) << 1) | (p[i] == '\0'));
+}
+
+int ByteMarks::next(char c, int from) const
+{
+    const uint isNul = (c == '\0');
+    QVector<uint>::const_iterator it(qLowerBound(marks.constBegin(), marks.constEnd(), uint(from) << 1));
+    for ( ; it != marks.constEnd(); ++it)
+        if ((*it & 1) == isNul)
+            return int(*it >> 1);
+
+    return -1;
+}
@@ -0,0 +1,28 @@
+#ifndef BYTESCAN_H
+#define BYTESCAN_H
+
+#include <QVector>
+
+/*
+   Line index of a block of 'git log' output, the offsets of all its
+   '\n' and '\0' bytes found in one pass, 16 or 32 bytes at a time with
+   SSE2 or AVX2 when the compiler targets them. Records are then split
+   and indexed looking up the offsets instead of scanning the data again,
+   see DataLoader::indexRecords() and Revision::indexData().
+
+   Bytes changed after the scan, as the '\0' fixups of Revision, are
+   not seen, so the block must be scanned before indexing its records.
+*/
+class ByteMarks
+{
+public:
+    void scan(const char* data, int from, int to);
+    void clear() { marks.clear(); }
+    int count() const { return marks.count(); }
+    int next(char c, int from) const; // c is '\n' or '\0', -1 if not found
+
+private:
+    QVector<uint> marks; // offset << 1 | isNul, ascending
+};
+
+#endif // BYTESCAN_H
@@ -0,0 +1,62 @@
+#include "pathtrie.h"
+
+#define UNKNOWN -2 // dirNodes entry not yet looked up, -1 is repository root
+
+void PathTrie::clear()
+{
+    nodes.clear();
+    dirNodes.clear();
+    dirsMap.clear();
+    filesMap.clear();
+}
+
+int PathTrie::addNode(int parent, bool isDir, SCRef path)
+{
+    Node n;
+    n.parent = parent;
+    n.isDir = isDir;
+    n.path = path;
+    nodes.append(n);
+    return nodes.count() - 1;
+}
+
+int PathTrie::dirNode(SCRef path)
+{
+    // path is empty for repository root, that has no node
+    if (path.isEmpty())
+        return -1;
+
+    QHash<QString, int>::const_iterator it(dirsMap.constFind(path));
+    if (it != dirsMap.constEnd())
+        return *it;
+
+    int sep = path.lastIndexOf('/', -2) + 1;
+    int parent = dirNode(path.left(sep));
+    int node = addNode(parent, true, path);
+    dirsMap.insert(path, node);
+    return node;
+}
+
+int PathTrie::dirNode(int dirIdx)
+{
+    while (dirNodes.count() <= dirIdx)
+        dirNodes.append(UNKNOWN);
+
+    if (dirNodes.at(dirIdx) == UNKNOWN)
+        dirNodes[dirIdx] = dirNode(dirNames.at(dirIdx));
+
+    return dirNodes.at(dirIdx);
+}
+
+int PathTrie::fileNode(int dirIdx, int nameIdx)
+{
+    const quint64 key = (quint64(uint(dirIdx)) << 32) | uint(nameIdx);
+    QHash<quint64, int>::const_iterator it(filesMap.constFind(key));
+    if (it != filesMap.constEnd())
+        return *it;
+
+    const QString fullPath(dirNames.at(dirIdx) + fileNames.at(nameIdx)); // built only once
+    int node = addNode(dirNode(dirIdx), false, fullPath);
+    filesMap.insert(key, node);
+    return node;
+}
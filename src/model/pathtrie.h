@@ -0,0 +1,56 @@
+#ifndef PATHTRIE_H
+#define PATHTRIE_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "common.h"
+
+/*
+   Interned paths of the files listed in RevFile, one node for each
+   directory and file, with the full path cached in the node.
+
+   RevFile stores paths as (directory, file name) index pairs into the
+   dirs and files vectors given to the constructor, that can only grow
+   until clear(). Nodes are added lazily the first time a pair or a
+   directory is asked for, so revisions decoded from the cache need no
+   extra step. Node ids are stable until clear() and can be used to
+   memoize per path results. A parent node is always added before its
+   children, so results of the directories can be propagated down in
+   a single pass over the nodes, see Git::getFileFilter().
+
+   Not thread safe, use it from GUI thread only.
+*/
+class PathTrie
+{
+public:
+    PathTrie(const StrVect& dirs, const StrVect& files) : dirNames(dirs), fileNames(files) {}
+    void clear();
+    int count() const { return nodes.count(); }
+    int fileNode(int dirIdx, int nameIdx);
+    int parent(int node) const { return nodes.at(node).parent; } // -1 if top level
+    bool isDir(int node) const { return nodes.at(node).isDir; }
+    const QString& path(int node) const { return nodes.at(node).path; }
+
+private:
+    PathTrie(const PathTrie&);
+    PathTrie& operator=(const PathTrie&);
+
+    struct Node {
+        int parent; // -1 for top level entries
+        bool isDir;
+        QString path;
+    };
+    int addNode(int parent, bool isDir, SCRef path);
+    int dirNode(int dirIdx);
+    int dirNode(SCRef path);
+
+    const StrVect& dirNames;
+    const StrVect& fileNames;
+    QVector<Node> nodes;
+    QVector<int> dirNodes;        // dirNames index -> node id
+    QHash<QString, int> dirsMap;  // all the directories, also intermediate ones
+    QHash<quint64, int> filesMap; // (dirNames index, fileNames index) -> node id
+};
+
+#endif // PATHTRIE_H
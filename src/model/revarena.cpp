@@ -0,0 +1,57 @@
+#include "revarena.h"
+
+#define SLAB_SIZE (256 * 1024)
+
+void* RevArena::alloc(int size)
+{
+    size = (size + 7) & ~7; // keep 8 bytes alignment
+
+    if (!spares.isEmpty()) {
+        QHash<int, QVector<void*> >::iterator it(spares.find(size));
+        if (it != spares.end()) {
+            void* p = (*it).last();
+            (*it).pop_back();
+            if ((*it).isEmpty())
+                spares.erase(it);
+            return p;
+        }
+    }
+    if (size > SLAB_SIZE / 4) { // big one, give it its own slab
+        char* p = new char[size];
+        slabs.prepend(p); // do not disturb current slab
+        return p;
+    }
+    if (size > left) {
+        cur = new char[SLAB_SIZE];
+        slabs.append(cur);
+        left = SLAB_SIZE;
+    }
+    void* p = cur;
+    cur += size;
+    left -= size;
+    return p;
+}
+
+void RevArena::release(void* p, int size)
+{
+    // the last allocation is just taken back, others are reused
+    // by next alloc() of the same size. Object in 'p' must be dead
+    size = (size + 7) & ~7;
+    if (static_cast<char*>(p) + size == cur) {
+        cur -= size;
+        left += size;
+    } else
+        spares[size].append(p);
+}
+
+void RevArena::clear()
+{
+    // O(number of slabs), no per object work
+    for (int i = 0; i < slabs.count(); i++)
+        delete[] slabs.at(i);
+
+    slabs.clear();
+    spares.clear();
+    cur = NULL;
+    left = 0;
+}
@@ -0,0 +1,104 @@
+#ifndef REVARENA_H
+#define REVARENA_H
+
+#include <string.h>
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+/*
+   Slab allocator for Revision objects and their per row vectors.
+
+   Memory is handed out from big slabs with a bump pointer and is never
+   freed alone, everything is released at once by clear(). Objects
+   allocated here must be trivially destructible because no destructor
+   is ever called. An allocation that turned out unused, as the one of
+   a not complete record, can be given back with release() and is then
+   handed out again. Not thread safe, use it from GUI thread only.
+*/
+class RevArena
+{
+public:
+    RevArena() : cur(NULL), left(0) {}
+    ~RevArena() { clear(); }
+    void* alloc(int size);
+    template<typename T> T* allocArray(int n) { return static_cast<T*>(alloc(n * sizeof(T))); }
+    void release(void* p, int size);
+    void clear();
+
+private:
+    RevArena(const RevArena&);
+    RevArena& operator=(const RevArena&);
+
+    QList<char*> slabs;
+    char* cur;
+    int left;
+    QHash<int, QVector<void*> > spares; // released ones, by size
+};
+
+/*
+   A minimal vector of plain old data stored in a RevArena.
+
+   It has a trivial destructor and a copy shares the data, as QVector
+   implicit sharing does. A copy has no spare capacity so that next
+   append() reallocates instead of writing in shared data, while clear()
+   just drops the data. That's why there is no non const operator[].
+   Old data is not reused when growing, it is reclaimed with the arena.
+*/
+template<typename T>
+class ArenaVector
+{
+public:
+    ArenaVector() : d(NULL), sz(0), cap(0) {}
+    ArenaVector(const ArenaVector& o) : d(o.d), sz(o.sz), cap(o.sz) {}
+    ArenaVector& operator=(const ArenaVector& o) { d = o.d; sz = cap = o.sz; return *this; }
+
+    int count() const { return sz; }
+    int size() const { return sz; }
+    bool isEmpty() const { return sz == 0; }
+    const T& at(int i) const { return d[i]; }
+    const T& operator[](int i) const { return d[i]; }
+    const T* constBegin() const { return d; }
+    const T* constEnd() const { return d + sz; }
+
+    void clear() { d = NULL; sz = cap = 0; }
+    void append(const T& t, RevArena& a) {
+
+        if (sz == cap)
+            grow(a, sz ? 2 * sz : 4);
+        d[sz++] = t;
+    }
+    template<typename S>
+    void assign(const QVector<S>& v, RevArena& a) { // S must convert to T
+
+        clear();
+        if (!v.isEmpty()) {
+            grow(a, v.count());
+            for (int i = 0; i < v.count(); i++)
+                d[i] = v.at(i);
+            sz = v.count();
+        }
+    }
+    const QVector<T> toVector() const {
+
+        QVector<T> v(sz);
+        if (sz)
+            memcpy(v.data(), d, sz * sizeof(T));
+        return v;
+    }
+
+private:
+    void grow(RevArena& a, int newCap) {
+
+        T* nd = a.allocArray<T>(newCap);
+        if (sz)
+            memcpy(nd, d, sz * sizeof(T));
+        d = nd;
+        cap = newCap;
+    }
+    T* d;
+    int sz;
+    int cap;
+};
+
+#endif // REVARENA_H
@@ -0,0 +1,301 @@
+#include <string.h>
+#include <QtAlgorithms>
+#include "revbitmap.h"
+
+#define CHUNK_WORDS 1024 // 65536 bits
+#define ARRAY_MAX   4096 // above this a bitmap is smaller than an array
+
+static inline int popCount(quint64 w) {
+
+    w = w - ((w >> 1) & Q_UINT64_C(0x5555555555555555));
+    w = (w & Q_UINT64_C(0x3333333333333333)) + ((w >> 2) & Q_UINT64_C(0x3333333333333333));
+    w = (w + (w >> 4)) & Q_UINT64_C(0x0F0F0F0F0F0F0F0F);
+    return int((w * Q_UINT64_C(0x0101010101010101)) >> 56);
+}
+
+static inline int lowestBit(quint64 w) { // w must be not zero
+
+    return popCount((w & (~w + 1)) - 1);
+}
+
+static void setRange(quint64* w, uint first, uint last) {
+
+    for (uint i = first; i <= last; i++) // runs are set word by word when aligned
+        if ((i & 63) == 0 && i + 63 <= last) {
+            w[i >> 6] = ~Q_UINT64_C(0);
+            i += 63;
+        } else
+            w[i >> 6] |= Q_UINT64_C(1) << (i & 63);
+}
+
+int RevBitmap::lowerBound(quint16 key) const {
+
+    int lo = 0, hi = chunks.count();
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (chunks.at(mid).key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+bool RevBitmap::contains(const Chunk& c, quint16 low) {
+
+    if (c.type == BITMAP)
+        return (c.words.at(low >> 6) >> (low & 63)) & 1;
+
+    if (c.type == ARRAY)
+        return qBinaryFind(c.data.constBegin(), c.data.constEnd(), low) != c.data.constEnd();
+
+    // find last run starting at or before low
+    int lo = 0, hi = c.data.count() / 2;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (c.data.at(2 * mid) <= low)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo > 0 && low <= c.data.at(2 * lo - 1);
+}
+
+void RevBitmap::toWords(const Chunk& c, quint64* w) {
+
+    if (c.type == BITMAP) {
+        memcpy(w, c.words.constData(), CHUNK_WORDS * sizeof(quint64));
+        return;
+    }
+    memset(w, 0, CHUNK_WORDS * sizeof(quint64));
+    if (c.type == ARRAY)
+        for (int i = 0; i < c.data.count(); i++)
+            w[c.data.at(i) >> 6] |= Q_UINT64_C(1) << (c.data.at(i) & 63);
+    else
+        for (int i = 0; i < c.data.count(); i += 2)
+            setRange(w, c.data.at(i), c.data.at(i + 1));
+}
+
+void RevBitmap::fromWords(Chunk& c, const quint64* w) {
+/*
+   Choose the smallest container for the chunk: an array takes
+   2 bytes per value, runs 4 bytes per run and a bitmap 8KB.
+*/
+    int card = 0, runs = 0;
+    quint64 carry = 0;
+    for (int i = 0; i < CHUNK_WORDS; i++) {
+        card += popCount(w[i]);
+        runs += popCount(w[i] & ~((w[i] << 1) | carry)); // count run starts
+        carry = w[i] >> 63;
+    }
+    c.card = card;
+    c.data.clear();
+    c.words.clear();
+
+    if (4 * runs <= 2 * card && 4 * runs < 8 * CHUNK_WORDS) {
+        c.type = RUNS;
+        c.data.reserve(2 * runs);
+        bool inRun = false;
+        for (uint i = 0; i < CHUNK_WORDS; i++) {
+            if ((w[i] == 0 && !inRun) || (w[i] == ~Q_UINT64_C(0) && inRun))
+                continue;
+
+            for (uint b = i * 64; b < i * 64 + 64; b++) {
+                bool set = (w[i] >> (b & 63)) & 1;
+                if (set && !inRun)
+                    c.data.append(b);
+                else if (!set && inRun)
+                    c.data.append(b - 1);
+                inRun = set;
+            }
+        }
+        if (inRun)
+            c.data.append(CHUNK_WORDS * 64 - 1);
+
+    } else if (card <= ARRAY_MAX) {
+        c.type = ARRAY;
+        c.data.reserve(card);
+        for (int i = 0; i < CHUNK_WORDS; i++)
+            for (quint64 b = w[i]; b; b &= b - 1)
+                c.data.append(i * 64 + lowestBit(b));
+    } else {
+        c.type = BITMAP;
+        c.words.resize(CHUNK_WORDS);
+        memcpy(c.words.data(), w, CHUNK_WORDS * sizeof(quint64));
+    }
+}
+
+void RevBitmap::unite(Chunk& c, const Chunk& o) {
+
+    if (c.type == ARRAY && o.type == ARRAY && c.card + o.card <= ARRAY_MAX) {
+
+        QVector<quint16> dst;
+        dst.reserve(c.card + o.card);
+        const quint16 *a = c.data.constBegin(), *aEnd = c.data.constEnd();
+        const quint16 *b = o.data.constBegin(), *bEnd = o.data.constEnd();
+        while (a != aEnd || b != bEnd) {
+            if (b == bEnd || (a != aEnd && *a < *b))
+                dst.append(*a++);
+            else if (a == aEnd || *b < *a)
+                dst.append(*b++);
+            else {
+                dst.append(*a++);
+                b++;
+            }
+        }
+        c.data = dst;
+        c.card = dst.count();
+        return;
+    }
+    if (c.type == RUNS && o.type == RUNS) {
+
+        // merge the two sorted run lists, coalescing overlapping
+        // and adjacent runs, no need to expand them
+        QVector<quint16> dst;
+        dst.reserve(c.data.count() + o.data.count());
+        int i = 0, j = 0, card = 0;
+        while (i < c.data.count() || j < o.data.count()) {
+            const QVector<quint16>& src = (j == o.data.count() || (i < c.data.count()
+                                           && c.data.at(i) < o.data.at(j))) ? c.data : o.data;
+            int& k = (&src == &c.data ? i : j);
+            uint first = src.at(k), last = src.at(k + 1);
+            k += 2;
+            if (!dst.isEmpty() && first <= uint(dst.last()) + 1) {
+                if (last > dst.last()) {
+                    card += last - dst.last();
+                    dst.last() = last;
+                }
+            } else {
+                dst.append(first);
+                dst.append(last);
+                card += last - first + 1;
+            }
+        }
+        c.data = dst;
+        c.card = card;
+        return;
+    }
+    quint64 w[CHUNK_WORDS], ow[CHUNK_WORDS];
+    toWords(c, w);
+    toWords(o, ow);
+    for (int i = 0; i < CHUNK_WORDS; i++)
+        w[i] |= ow[i];
+
+    fromWords(c, w);
+}
+
+int RevBitmap::count() const {
+
+    int cnt = 0;
+    for (int i = 0; i < chunks.count(); i++)
+        cnt += chunks.at(i).card;
+
+    return cnt;
+}
+
+bool RevBitmap::contains(uint v) const {
+
+    int idx = lowerBound(v >> 16);
+    if (idx == chunks.count() || chunks.at(idx).key != (v >> 16))
+        return false;
+
+    return contains(chunks.at(idx), v & 0xFFFF);
+}
+
+void RevBitmap::insert(uint v) {
+
+    quint16 key = v >> 16, low = v & 0xFFFF;
+    int idx = lowerBound(key);
+    if (idx == chunks.count() || chunks.at(idx).key != key) {
+        Chunk c;
+        c.key = key;
+        c.type = ARRAY;
+        c.card = 1;
+        c.data.append(low);
+        chunks.insert(idx, c);
+        return;
+    }
+    if (contains(chunks.at(idx), low))
+        return;
+
+    Chunk& c = chunks[idx];
+    if (   c.type == ARRAY && low == c.data.last() + 1
+        && c.data.last() - c.data.first() + 1 == c.card) { // becomes a run
+
+        quint16 first = c.data.first();
+        c.data.clear();
+        c.data.append(first);
+        c.data.append(low);
+        c.type = RUNS;
+        c.card++;
+        return;
+    }
+    if (c.type == ARRAY && c.card < ARRAY_MAX) {
+        c.data.insert(qLowerBound(c.data.begin(), c.data.end(), low), low);
+        c.card++;
+        return;
+    }
+    if (c.type == BITMAP) {
+        c.words[low >> 6] |= Q_UINT64_C(1) << (low & 63);
+        c.card++;
+        return;
+    }
+    if (c.type == RUNS && low == c.data.last() + 1) { // common case, slots
+        c.data.last() = low;                          // are given in order
+        c.card++;
+        return;
+    }
+    quint64 w[CHUNK_WORDS];
+    toWords(c, w);
+    w[low >> 6] |= Q_UINT64_C(1) << (low & 63);
+    fromWords(c, w);
+}
+
+RevBitmap& RevBitmap::operator|=(const RevBitmap& o) {
+
+    if (isEmpty() || o.isEmpty()) {
+        if (isEmpty())
+            chunks = o.chunks;
+        return *this;
+    }
+    QVector<Chunk> dst;
+    dst.reserve(chunks.count() + o.chunks.count());
+    int i = 0, j = 0;
+    while (i < chunks.count() || j < o.chunks.count()) {
+        if (j == o.chunks.count() || (i < chunks.count() && chunks.at(i).key < o.chunks.at(j).key))
+            dst.append(chunks.at(i++));
+        else if (i == chunks.count() || o.chunks.at(j).key < chunks.at(i).key)
+            dst.append(o.chunks.at(j++));
+        else {
+            dst.append(chunks.at(i++));
+            unite(dst.last(), o.chunks.at(j++));
+        }
+    }
+    chunks = dst;
+    return *this;
+}
+
+const QVector<uint> RevBitmap::toVector() const {
+
+    QVector<uint> v;
+    v.reserve(count());
+    for (int i = 0; i < chunks.count(); i++) {
+
+        const Chunk& c = chunks.at(i);
+        uint base = uint(c.key) << 16;
+
+        if (c.type == ARRAY)
+            for (int j = 0; j < c.data.count(); j++)
+                v.append(base | c.data.at(j));
+
+        else if (c.type == RUNS)
+            for (int j = 0; j < c.data.count(); j += 2)
+                for (uint k = c.data.at(j); k <= c.data.at(j + 1); k++)
+                    v.append(base | k);
+        else
+            for (int j = 0; j < CHUNK_WORDS; j++)
+                for (quint64 b = c.words.at(j); b; b &= b - 1)
+                    v.append(base | (j * 64 + lowestBit(b)));
+    }
+    return v;
+}
@@ -0,0 +1,48 @@
+#ifndef REVBITMAP_H
+#define REVBITMAP_H
+
+#include <QVector>
+
+/*
+   Compressed set of unsigned integers, in roaring bitmap style.
+
+   Values are split in chunks by their high 16 bits, each chunk is
+   stored in the smallest of three containers: a sorted array of the
+   low 16 bits for sparse chunks, a 65536 bits bitmap for dense ones or
+   a list of runs of consecutive values. Slots numbered in graph order
+   tend to form long runs, so big sets stay small. Copies are cheap,
+   data is implicitly shared.
+*/
+class RevBitmap
+{
+public:
+    bool isEmpty() const { return chunks.isEmpty(); }
+    int count() const;
+    bool contains(uint v) const;
+    void insert(uint v);
+    RevBitmap& operator|=(const RevBitmap& o);
+    const QVector<uint> toVector() const; // sorted
+
+private:
+    enum ChunkType {
+        ARRAY,  // sorted low bits
+        BITMAP, // one bit per value
+        RUNS    // (first, last) pairs
+    };
+    struct Chunk {
+        quint16 key;
+        quint8 type;
+        int card;
+        QVector<quint16> data;  // ARRAY and RUNS
+        QVector<quint64> words; // BITMAP
+    };
+    int lowerBound(quint16 key) const;
+    static bool contains(const Chunk& c, quint16 low);
+    static void toWords(const Chunk& c, quint64* w);
+    static void fromWords(Chunk& c, const quint64* w);
+    static void unite(Chunk& c, const Chunk& o);
+
+    QVector<Chunk> chunks; // sorted by key
+};
+
+#endif // REVBITMAP_H
@@ -1,3 +1,4 @@
+#include "bytescan.h"
 #include "revision.h"
 #include "common.h"
 
@@ -15,8 +16,9 @@ const QString Revision::midSha(int start, int len) const
     return QString::fromLatin1(data + start, len); // faster then formAscii
 }
 
-const ShaString Revision::parent(int idx) const
+const ShaString Revision::octopusParent(int idx) const
 {
+    // only first parents are stored, see indexData()
     // FIXME: Magic numbers!
     return ShaString(ba.constData() + shaStart + 41 + 41 * idx);
 }
@@ -35,7 +37,13 @@ const QStringList Revision::parents() const
     return p;
 }
 
-int Revision::indexData(bool quick, bool withDiff) const {
+int Revision::find(char c, int from, const ByteMarks* bm) const
+{
+    // line index lookup if available, no data scanning
+    return (bm ? bm->next(c, from) : ba.indexOf(c, from));
+}
+
+int Revision::indexData(bool quick, bool withDiff, const ByteMarks* bm) const {
 /*
   This is what 'git log' produces:
 
@@ -65,7 +73,7 @@ int Revision::indexData(bool quick, bool withDiff) const {
         return -1;
 
     if (data[start] == 'F') // "Final output", let caller handle this
-        return (ba.indexOf('\n', start) != -1 ? -2 : -1);
+        return (find('\n', start, bm) != -1 ? -2 : -1);
 
     // parse log size if present
     if (data[idx] == 'l') { // 'log size xxx\n'
@@ -79,34 +87,43 @@ int Revision::indexData(bool quick, bool withDiff) const {
     if (++idx + 42 > last)
         return -1;
 
-    shaStart = idx;
-
-    // ok, now shaStart is valid but msgSize
+    // ok, now sha start is valid but msgSize
     // could be still 0 if not available
-    logEnd = shaStart - 1 + logSize;
+    logEnd = idx - 1 + logSize;
     if (logEnd > last)
         return -1;
 
-    idx += 40; // now points to 'X' place holder
+    // sha line is parsed only the first time, when called again by setup()
+    // lanes and tree index workers could be reading sha and parents
+    if (end > 0)
+        idx = comStart - 1;
+    else {
+        shaStart = idx;
+        idx += 40; // now points to 'X' place holder
 
-    fixup[idx] = '\0'; // we want sha to be a '\0' terminated ascii string
+        fixup[idx] = '\0'; // we want sha to be a '\0' terminated ascii string
+        shaId = ShaString(data + shaStart);
 
-    parentsCnt = 0;
+        parentsCnt = 0;
 
-    if (data[idx + 2] == '\n') // initial revision
-        ++idx;
-    else do {
-        parentsCnt++;
-        idx += 41;
+        if (data[idx + 2] == '\n') // initial revision
+            ++idx;
+        else do {
+            parentsCnt++;
+            idx += 41;
 
-        if (idx + 1 >= last)
-            break;
+            if (idx + 1 >= last)
+                break;
 
-        fixup[idx] = '\0'; // we want parents '\0' terminated
+            fixup[idx] = '\0'; // we want parents '\0' terminated
+            if (parentsCnt <= PARENT_IDS)
+                parentIds[parentsCnt - 1] = ShaString(data + idx - 40);
 
-    } while (data[idx + 1] != '\n');
+        } while (data[idx + 1] != '\n');
 
-    ++idx; // now points to the trailing '\n' of sha line
+        ++idx; // now points to the trailing '\n' of sha line
+        comStart = idx + 1;
+    }
 
     // check for !msgSize
     if (withDiff || !logSize) {
@@ -114,7 +131,7 @@ int Revision::indexData(bool quick, bool withDiff) const {
         revEnd = (logEnd > idx) ? logEnd - 1: idx;
         do { // search for "\n\0" to handle (rare) cases of '\0'
              // in content, see c42012 and bb8d8a6 in Linux tree
-            revEnd = ba.indexOf('\0', revEnd + 1);
+            revEnd = find('\0', revEnd + 1, bm);
             if (revEnd == -1)
                 return -1;
 
@@ -132,15 +149,14 @@ int Revision::indexData(bool quick, bool withDiff) const {
     if (quick && !withDiff)
         return ++revEnd;
 
-    comStart = ++idx;
-    idx = ba.indexOf('\n', idx); // committer line end
+    idx = find('\n', comStart, bm); // committer line end
     if (idx == -1) {
         dbs("ASSERT in indexData: unexpected end of data");
         return -1;
     }
 
     autStart = ++idx;
-    idx = ba.indexOf('\n', idx); // author line end
+    idx = find('\n', idx, bm); // author line end
     if (idx == -1) {
         dbs("ASSERT in indexData: unexpected end of data");
         return -1;
@@ -168,7 +184,7 @@ int Revision::indexData(bool quick, bool withDiff) const {
         sLogStart = sLogLen = 0;
         lLogStart = lLogLen = 0;
     } else {
-        lLogStart = ba.indexOf('\n', sLogStart);
+        lLogStart = find('\n', sLogStart, bm);
         if (lLogStart != -1 && lLogStart < logEnd - 1) {
 
             sLogLen = lLogStart - sLogStart; // skip sLog trailing '\n'
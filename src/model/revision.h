@@ -7,63 +7,81 @@
 #include <QVector>
 #include <QStringList>
 #include "shastring.h"
+#include "revarena.h"
 #include "lanes.h" // FIXME: model or view?
 
+class ByteMarks;
+
 class Revision
 {
     // prevent implicit C++ compiler defaults
     Revision();
     Revision(const Revision&);
     Revision& operator=(const Revision&);
+
+    // revisions live in the FileHistory arena and are never deleted alone
+    static void operator delete(void*);
 public:
-    Revision(const QByteArray& b, uint s, int idx, int* next, bool withDiff)
-        : orderIdx(idx), ba(b), start(s) {
+    static void* operator new(size_t size, RevArena& a) { return a.alloc(size); }
+    static void* operator new(size_t, void* mem) { return mem; } // see DataLoader
+    static void operator delete(void*, RevArena&) {}
+    static void operator delete(void*, void*) {}
+
+    // with a line index of 'b' the record is fully indexed at once
+    Revision(const QByteArray& b, uint s, int idx, int* next, bool withDiff, const ByteMarks* bm = NULL)
+        : orderIdx(idx), ba(b), start(s), end(0) {
 
         indexed = isDiffCache = isApplied = isUnApplied = false;
-        descRefsMaster = ancRefsMaster = descBrnMaster = -1;
-        *next = indexData(true, withDiff);
+        end = *next = indexData(!bm, withDiff, bm);
     }
     bool isDiffCache; //
     bool isApplied;   //
     bool isUnApplied; // put here to optimize padding
     bool isBoundary() const { return (ba.at(shaStart - 1) == '-'); }
     uint parentsCount() const { return parentsCnt; }
-    const ShaString parent(int idx) const;
+    const ShaString parent(int idx) const { return (idx < PARENT_IDS ? parentIds[idx] : octopusParent(idx)); }
     const QStringList parents() const;
-    const ShaString sha() const { return ShaString(ba.constData() + shaStart); }
+    const ShaString& sha() const { return shaId; }
     const QString committer() const { setup(); return mid(comStart, autStart - comStart - 1); }
     const QString author() const { setup(); return mid(autStart, autDateStart - autStart - 1); }
     const QString authorDate() const { setup(); return mid(autDateStart, 10); }
     const QString shortLog() const { setup(); return mid(sLogStart, sLogLen); }
     const QString longLog() const { setup(); return mid(lLogStart, lLogLen); }
     const QString diff() const { setup(); return mid(diffStart, diffLen); }
+    const QByteArray rawRecord() const { return QByteArray::fromRawData(ba.constData() + start, end - start); }
 
-    QVector<LaneType> lanes;
-    QVector<int> childs;
-    QVector<int> descRefs;     // list of descendant refs index, normally tags
-    QVector<int> ancRefs;      // list of ancestor refs index, normally tags
-    QVector<int> descBranches; // list of descendant branches index
-    int descRefsMaster; // in case of many Rev have the same descRefs, ancRefs or
-    int ancRefsMaster;  // descBranches these are stored only once in a Rev pointed
-    int descBrnMaster;  // by corresponding index xxxMaster
-    int orderIdx;
+    // no copy nor conversion, data is valid while the revision is alive
+    const QByteArray rawAuthor() const { setup(); return rawMid(autStart, autDateStart - autStart - 1); }
+    const QByteArray rawShortLog() const { setup(); return rawMid(sLogStart, sLogLen); }
+    const QByteArray rawLongLog() const { setup(); return rawMid(lLogStart, lLogLen); }
+
+    ArenaVector<PackedLane> lanes;
+    int orderIdx; // children, branches and tags info is in TreeIndex
 private:
     inline void setup() const { if (!indexed) indexData(false, false); }
-    int indexData(bool quick, bool withDiff) const;
+    int indexData(bool quick, bool withDiff, const ByteMarks* bm = NULL) const;
+    int find(char c, int from, const ByteMarks* bm) const;
+    enum { PARENT_IDS = 2 }; // parents parsed while indexing, enough but for octopus merges
+
+    const ShaString octopusParent(int idx) const;
     const QString mid(int start, int len) const;
     const QString midSha(int start, int len) const;
+    const QByteArray rawMid(int start, int len) const { return QByteArray::fromRawData(ba.constData() + start, len); }
 
     const QByteArray& ba; // reference here!
     const int start;
+    int end; // one past the terminating '\0', as returned by indexData(), 0 until then
     // FIXME: Soo many operators in one line
     // {
     mutable int parentsCnt, shaStart, comStart, autStart, autDateStart;
     mutable int sLogStart, sLogLen, lLogStart, lLogLen, diffStart, diffLen;
     // }
+    mutable ShaString shaId; // parsed once, while indexing
+    mutable ShaString parentIds[PARENT_IDS];
     mutable bool indexed;
 };
 
 // FIXME: include in class
-typedef QHash<ShaString, const Revision*> RevMap;  // faster then a map
+typedef QHash<ShaString, QVector<const Revision*> > MergeRevMap;
 
 #endif // REVISION_H
@@ -0,0 +1,118 @@
+#include "revmap.h"
+#include "common.h"
+
+#define MIN_TABLE_SIZE 64
+
+int RevMap::find(const ShaString& sha, uint h) const
+{
+// returns the slot of 'sha' or, if not found, the empty slot
+// where it should be inserted. Table must not be empty
+
+    uint i = h & mask;
+    while (true) {
+        const Slot& s = table.at(i);
+        if (s.idx == -1 || (s.hash == h && revs.at(s.idx)->sha() == sha))
+            return i;
+
+        i = (i + 1) & mask;
+    }
+}
+
+const Revision* RevMap::value(const ShaString& sha) const
+{
+    if (cnt == 0)
+        return NULL;
+
+    int idx = table.at(find(sha, qHash(sha))).idx;
+    return (idx != -1 ? revs.at(idx) : NULL);
+}
+
+void RevMap::insert(const ShaString& sha, const Revision* r)
+{
+    // keep load factor under 50% so that probe sequences stay short
+    if ((cnt + 1) * 2 > table.size())
+        rehash(qMax(table.size() * 2, MIN_TABLE_SIZE));
+
+    if (r->orderIdx >= revs.size())
+        revs.resize(r->orderIdx + 1); // new entries are NULL
+
+    uint h = qHash(sha);
+    Slot& s = table[find(sha, h)];
+    if (s.idx == -1) {
+        s.hash = h;
+        cnt++;
+    }
+    s.idx = r->orderIdx; // overwrite old content, if any
+    revs[s.idx] = r;
+}
+
+void RevMap::remove(const ShaString& sha)
+{
+    if (cnt == 0)
+        return;
+
+    uint i = find(sha, qHash(sha));
+    if (table.at(i).idx == -1)
+        return;
+
+    revs[table.at(i).idx] = NULL;
+    cnt--;
+
+    // backward shift deletion: move up following entries of the
+    // same probe sequence, so that no tombstones are needed
+    uint j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        const Slot& s = table.at(j);
+        if (s.idx == -1)
+            break;
+
+        uint home = s.hash & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            table[i] = s;
+            i = j;
+        }
+    }
+    table[i].idx = -1;
+}
+
+void RevMap::reserve(int size)
+{
+    int n = MIN_TABLE_SIZE;
+    while (n < size * 2)
+        n *= 2;
+
+    if (n > table.size())
+        rehash(n);
+
+    revs.reserve(size);
+}
+
+void RevMap::clear()
+{
+    table.clear();
+    revs.clear();
+    cnt = 0;
+    mask = 0;
+}
+
+void RevMap::rehash(int size)
+{
+    // size must be a power of two
+    const Slot empty = { 0, -1 };
+    const QVector<Slot> old(table);
+    table = QVector<Slot>(size, empty);
+    mask = size - 1;
+
+    FOREACH (QVector<Slot>, it, old) {
+
+        if ((*it).idx == -1)
+            continue;
+
+        uint i = (*it).hash & mask;
+        while (table.at(i).idx != -1)
+            i = (i + 1) & mask;
+
+        table[i] = *it;
+    }
+}
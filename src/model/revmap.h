@@ -0,0 +1,49 @@
+#ifndef REVMAP_H
+#define REVMAP_H
+
+#include <QVector>
+#include "shastring.h"
+#include "revision.h"
+
+/*
+   Revision lookup table, used in fast path by Git::revLookup().
+
+   Revisions are stored contiguously, indexed by orderIdx, while sha
+   lookup is done with an open addressing, linear probing table of
+   (hash, orderIdx) slots. So a probe is just a scan of adjacent
+   slots without any node allocation or pointer chasing, the revision
+   is accessed only to confirm a hash hit.
+*/
+class RevMap
+{
+public:
+    RevMap() : cnt(0), mask(0) {}
+
+    const Revision* value(const ShaString& sha) const;
+    const Revision* operator[](const ShaString& sha) const { return value(sha); }
+    bool contains(const ShaString& sha) const { return value(sha) != NULL; }
+    void insert(const ShaString& sha, const Revision* r); // sha must be r->sha()
+    void remove(const ShaString& sha);
+    void reserve(int size);
+    void clear();
+    int count() const { return cnt; }
+    bool isEmpty() const { return cnt == 0; }
+
+    // indexed by orderIdx, could have NULL holes
+    const QVector<const Revision*>& values() const { return revs; }
+
+private:
+    struct Slot {
+        uint hash;
+        int idx; // -1 if empty
+    };
+    int find(const ShaString& sha, uint h) const;
+    void rehash(int size);
+
+    QVector<Slot> table;
+    QVector<const Revision*> revs;
+    int cnt;
+    uint mask;
+};
+
+#endif // REVMAP_H
@@ -0,0 +1,188 @@
+#include <QDateTime>
+#include "revision.h"
+#include "revquery.h"
+
+static bool costLessThan(const RevQuery::Term& a, const RevQuery::Term& b) {
+
+    return (a.field < b.field);
+}
+
+bool RevQuery::compile(SCRef text)
+{
+    terms.clear();
+    errorMsg = "";
+    const int len = text.length();
+    int i = 0;
+    while (true) {
+
+        while (i < len && text.at(i).isSpace())
+            i++;
+
+        if (i == len)
+            break;
+
+        bool negated = (text.at(i) == '-');
+        if (negated)
+            i++;
+
+        // optional field name
+        QString name;
+        int start = i;
+        while (i < len && text.at(i).isLetter())
+            i++;
+
+        if (i > start && i < len && text.at(i) == ':') {
+            name = text.mid(start, i - start).toLower();
+            i++;
+        } else
+            i = start;
+
+        // value is quoted, in slashes or up to next space
+        QString value;
+        QChar delim(i < len ? text.at(i) : QChar());
+        if (delim == '"' || delim == '/') {
+
+            // an escaped slash does not close a regexp
+            int end = i + 1;
+            while (   end < len
+                   && (text.at(end) != delim || (delim == '/' && text.at(end - 1) == '\\')))
+                end++;
+
+            if (end == len) {
+                errorMsg = QString("Missing closing %1 in query").arg(delim);
+                return false;
+            }
+            value = text.mid(i + 1, end - i - 1);
+            if (delim == '/')
+                value.replace("\\/", "/");
+            i = end + 1;
+        } else {
+            start = i;
+            while (i < len && !text.at(i).isSpace())
+                i++;
+
+            value = text.mid(start, i - start);
+        }
+        if (!addTerm(name, value, negated, delim == '/'))
+            return false;
+    }
+    if (terms.isEmpty()) {
+        errorMsg = "Empty query";
+        return false;
+    }
+    qStableSort(terms.begin(), terms.end(), costLessThan);
+    return true;
+}
+
+bool RevQuery::addTerm(SCRef name, SCRef value, bool negated, bool isRegExp)
+{
+    Term t;
+    t.negated = negated;
+    t.isRegExp = isRegExp;
+    t.value = value;
+    t.time = 0;
+
+    if (name.isEmpty() && !isRegExp && value.toLower() == "merge")
+        t.field = MERGE;
+    else if (name.isEmpty() || name == "subject" || name == "log")
+        t.field = SUBJECT;
+    else if (name == "msg")
+        t.field = MSG;
+    else if (name == "author")
+        t.field = AUTHOR;
+    else if (name == "sha" || name == "commit")
+        t.field = SHA;
+    else if (name == "path" || name == "file")
+        t.field = PATH;
+    else if (name == "patch")
+        t.field = PATCH;
+    else if (name == "after" || name == "since")
+        t.field = AFTER;
+    else if (name == "before" || name == "until")
+        t.field = BEFORE;
+    else {
+        errorMsg = QString("Unknown query field '%1'").arg(name);
+        return false;
+    }
+    if (value.isEmpty()) {
+        errorMsg = "Missing value in query";
+        return false;
+    }
+    if (t.field == AFTER || t.field == BEFORE) {
+
+        // author date, from the start of the given day
+        QDate d(QDate::fromString(value, Qt::ISODate));
+        if (isRegExp || !d.isValid()) {
+            errorMsg = QString("Bad date '%1', use YYYY-MM-DD").arg(value);
+            return false;
+        }
+        t.time = QDateTime(d).toTime_t();
+
+    } else if (t.field == PATCH) {
+
+        // given to 'git diff-tree -S' as is, it can't be negated
+        if (negated || patchTerm()) {
+            errorMsg = "Only one, not negated, patch term is allowed";
+            return false;
+        }
+    } else if (t.field != MERGE) {
+
+        t.rx = QRegExp(value, Qt::CaseInsensitive, isRegExp ? QRegExp::RegExp : QRegExp::Wildcard);
+        if (!t.rx.isValid()) {
+            errorMsg = QString("Bad regular expression '%1'").arg(value);
+            return false;
+        }
+    }
+    terms.append(t);
+    return true;
+}
+
+const RevQuery::Term* RevQuery::patchTerm() const
+{
+    // if any it is the last one, once sorted
+    for (int i = 0; i < terms.count(); i++)
+        if (terms.at(i).field == PATCH)
+            return &terms.at(i);
+
+    return NULL;
+}
+
+bool RevQuery::isMatch(int i, const Revision* r)
+{
+    Term& t = terms[i];
+    bool match;
+    switch (t.field) {
+    case MERGE:
+        match = (r->parentsCount() > 1);
+        break;
+    case AFTER:
+        match = (r->authorDate().toUInt() >= t.time);
+        break;
+    case BEFORE:
+        match = (r->authorDate().toUInt() < t.time);
+        break;
+    case SHA:
+        match = QString(r->sha()).contains(t.rx);
+        break;
+    case AUTHOR: {
+        const QByteArray a(r->rawAuthor());
+        QHash<QByteArray, bool>::const_iterator it(t.seen.constFind(a));
+        if (it != t.seen.constEnd()) {
+            match = *it;
+            break;
+        }
+        match = r->author().contains(t.rx);
+        t.seen.insert(QByteArray(a.constData(), a.size()), match); // deep copy
+        break;
+    }
+    case SUBJECT:
+        match = r->shortLog().contains(t.rx);
+        break;
+    case MSG:
+        match = r->longLog().contains(t.rx);
+        break;
+    default:
+        return true; // path and patch terms are matched by Git
+    }
+    return (match != t.negated);
+}
@@ -0,0 +1,65 @@
+#ifndef REVQUERY_H
+#define REVQUERY_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QRegExp>
+#include <QString>
+#include "common.h"
+
+class Revision;
+
+/*
+   Multi-field filter of the revision list, as
+
+       author:marco path:src/net/* after:2024-01-01 msg:/fix(es)?/ -merge
+
+   All terms must match, a leading '-' negates one. Values are case
+   insensitive wildcards, as in the single field filters, or regular
+   expressions when enclosed in slashes. Quote a value to have spaces
+   in it. A word with no field is matched against the short log.
+
+   Terms are compiled and sorted by evaluation cost, so that the cheap
+   ones, as dates and parents count, discard most revisions before the
+   expensive ones are checked. Path and patch terms are not matched here,
+   see Git::getQueryFilter().
+*/
+class RevQuery
+{
+public:
+    enum Field { // in evaluation order, cheapest first
+        MERGE,
+        AFTER,
+        BEFORE,
+        SHA,
+        AUTHOR,
+        SUBJECT,
+        MSG,
+        PATH,
+        PATCH
+    };
+    struct Term {
+        Field field;
+        bool negated;
+        bool isRegExp;
+        QString value;
+        QRegExp rx;
+        uint time; // after and before, seconds since epoch
+        QHash<QByteArray, bool> seen; // author terms, each author is matched once
+    };
+    bool compile(SCRef text);
+    SCRef errorString() const { return errorMsg; }
+    int count() const { return terms.count(); }
+    const Term& term(int i) const { return terms.at(i); }
+    const Term* patchTerm() const;
+    bool isMatch(int i, const Revision* r);
+
+private:
+    bool addTerm(SCRef name, SCRef value, bool negated, bool isRegExp);
+
+    QList<Term> terms;
+    QString errorMsg;
+};
+
+#endif // REVQUERY_H
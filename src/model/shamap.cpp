@@ -13,7 +13,7 @@ uint ShaMap::checkRef(const ShaString& sha, uint typeMask) const
 
 uint ShaMap::checkRef(SCRef sha, uint typeMask) const
 {
-    return checkRef(QGit::toTempSha(sha), typeMask);
+    return checkRef(ShaString(sha), typeMask);
 }
 
 bool ShaMap::hasType(const ShaString& sha, Reference::Type type) const
@@ -28,7 +28,7 @@ bool ShaMap::hasType(SCRef sha, Reference::Type type) const
 
 const QStringList ShaMap::getRefName(SCRef sha, Reference::Type type) const
 {
-    return getRefName(QGit::toTempSha(sha), type);
+    return getRefName(ShaString(sha), type);
 }
 
 const QStringList ShaMap::getRefName(const ShaString& sha, Reference::Type type) const
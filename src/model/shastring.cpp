@@ -1 +1,65 @@
 #include "shastring.h"
+
+static inline int hexVal(uint ch)
+{
+    if (ch - '0' < 10)
+        return ch - '0';
+
+    ch |= 0x20; // to lower case
+    return (ch - 'a' < 6 ? ch - 'a' + 10 : -1);
+}
+
+ShaString::ShaString(const char* hex)
+{
+    // a NULL, short or not hex string gives a null sha
+    for (int i = 0; hex && i < RAW_SIZE; i++) {
+
+        int hi = hexVal((uchar)hex[2 * i]);
+        int lo = (hi != -1 ? hexVal((uchar)hex[2 * i + 1]) : -1);
+        if (lo == -1)
+            break;
+
+        raw[i] = (uchar)((hi << 4) | lo);
+        if (i == RAW_SIZE - 1)
+            return;
+    }
+    memset(raw, 0xff, RAW_SIZE);
+}
+
+ShaString::ShaString(const QString& hex)
+{
+    if (hex.length() >= HEX_SIZE)
+        *this = ShaString(hex.left(HEX_SIZE).toLatin1().constData());
+    else
+        memset(raw, 0xff, RAW_SIZE);
+}
+
+const ShaString ShaString::fromRaw(const char* data)
+{
+    ShaString s;
+    memcpy(s.raw, data, RAW_SIZE);
+    return s;
+}
+
+bool ShaString::isNull() const
+{
+    for (int i = 0; i < RAW_SIZE; i++)
+        if (raw[i] != 0xff)
+            return false;
+
+    return true;
+}
+
+const QString ShaString::toString() const
+{
+    if (isNull())
+        return QString();
+
+    static const char digits[] = "0123456789abcdef";
+    char hex[HEX_SIZE];
+    for (int i = 0; i < RAW_SIZE; i++) {
+        hex[2 * i]     = digits[raw[i] >> 4];
+        hex[2 * i + 1] = digits[raw[i] & 0xf];
+    }
+    return QString::fromLatin1(hex, HEX_SIZE);
+}
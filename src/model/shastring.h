@@ -1,21 +1,52 @@
 #ifndef SHASTRING_H
 #define SHASTRING_H
 
-#include <QLatin1String>
+#include <string.h>
+#include <QString>
+#include <QtGlobal>
 
-class ShaString : public QLatin1String
+/*
+   A git object id stored as 20 raw bytes instead of a 40 chars hex
+   string, it is the key of RevMap, RevFileMap and ShaMap. Conversion
+   from hex is explicit and happens only when parsing git output, while
+   conversion to hex is implicit, to feed UI and git command lines.
+
+   A null ShaString, as a default constructed one or one built from
+   an invalid hex string, has all bits set, so that it can never be
+   confused with ZERO_SHA (all bits cleared).
+*/
+class ShaString
 {
 public:
-    inline ShaString() : QLatin1String(NULL) {}
-    inline ShaString(const ShaString& sha) : QLatin1String(sha.latin1()) {}
-    inline explicit ShaString(const char* sha) : QLatin1String(sha) {}
+    enum { RAW_SIZE = 20, HEX_SIZE = 40 };
+
+    inline ShaString() { memset(raw, 0xff, RAW_SIZE); }
+    explicit ShaString(const char* hex);    // first 40 chars are parsed
+    explicit ShaString(const QString& hex);
+
+    static const ShaString fromRaw(const char* data);
+    const char* rawData() const { return reinterpret_cast<const char*>(raw); }
+
+    bool isNull() const;
+    const QString toString() const;
+    inline operator QString() const { return toString(); }
 
+    inline bool operator==(const ShaString& o) const { return !memcmp(raw, o.raw, RAW_SIZE); }
     inline bool operator!=(const ShaString& o) const { return !operator==(o); }
 
-    inline bool operator==(const ShaString& o) const
-    {
-        return (latin1() == o.latin1()) || !qstrcmp(latin1(), o.latin1());
-    }
+private:
+    friend uint qHash(const ShaString&);
+
+    uchar raw[RAW_SIZE];
 };
+Q_DECLARE_TYPEINFO(ShaString, Q_MOVABLE_TYPE);
+
+inline uint qHash(const ShaString& s) { // fast path, called 6-7 times per revision
+
+    // sha is already uniformly distributed, so its first word is a good hash
+    uint h;
+    memcpy(&h, s.raw, sizeof(h));
+    return h;
+}
 
 #endif // SHASTRING_H
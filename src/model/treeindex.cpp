@@ -0,0 +1,326 @@
+#include <QMap>
+#include <QPair>
+#include <QSet>
+#include "treeindex.h"
+
+TreeIndex::TreeIndex(const ShaVect& ro, const RevMap& r, const ShaMap& sm)
+    : buildId(0), revOrder(ro), revs(r), refs(sm) {}
+
+TreeIndex* TreeIndex::build(const ShaVect& ro, const RevMap& r, const ShaMap& sm,
+                            bool goDown, const QAtomicInt* generation)
+{
+// called in a worker thread, returns NULL if canceled by
+// a change of generation while building
+
+    const int id = *generation;
+    TreeIndex* t = new TreeIndex(ro, r, sm);
+    t->buildId = id;
+    const int cnt = ro.count();
+    t->nodes.resize(cnt);
+
+    // walk down the tree from latest to oldest,
+    // compute children and nearest descendants
+    for (int i = 0; i < cnt && *generation == id; i++) {
+
+        Node& n = t->nodes[i];
+        bool isB = t->isBranch(i);
+        bool isT = t->isTag(i);
+
+        if (isB) {
+            if (n.descBrnMaster != -1)
+                n.descBranches = t->nodes.at(n.descBrnMaster).descBranches;
+
+            n.descBranches.insert(t->branchIdx.count());
+            t->branchIdx.append(i);
+        }
+        if (isT)
+            t->addTag(i);
+
+        const Revision* rev = r.value(ro.at(i));
+        for (uint y = 0; y < rev->parentsCount(); y++) {
+
+            const Revision* pr = r.value(rev->parent(y));
+            if (!pr)
+                continue;
+
+            int p = pr->orderIdx;
+            Node& pn = t->nodes[p];
+            pn.childs.append(i, t->arena);
+            n.parents.append(p, t->arena);
+
+            if (pn.descBrnMaster == -1)
+                pn.descBrnMaster = isB ? i : n.descBrnMaster;
+            else
+                t->mergeBranches(p, i);
+
+            if (pn.descRefsMaster == -1)
+                pn.descRefsMaster = isT ? i : n.descRefsMaster;
+            else
+                t->mergeNearTags(goDown, p, i);
+        }
+    }
+    if (*generation == id)
+        t->computePostOrder();
+
+    // walk backward through the tree and compute nearest tagged
+    // ancestors, generation numbers and DFS intervals. Parents
+    // come always after their children in graph order, so they
+    // are final when we get here.
+    for (int i = cnt - 1; i >= 0 && *generation == id; i--) {
+
+        Node& n = t->nodes[i];
+        bool isT = (n.tagSlot != -1);
+
+        if (isT) {
+            n.ancRefs = RevBitmap();
+            n.ancRefs.insert(n.tagSlot);
+        }
+
+        for (int y = 0; y < n.childs.count(); y++) {
+
+            int c = n.childs[y];
+            Node& cn = t->nodes[c];
+            cn.gen = qMax(cn.gen, n.gen + 1);
+            cn.low = qMin(cn.low, n.low);
+
+            if (cn.ancRefsMaster == -1)
+                cn.ancRefsMaster = isT ? i : n.ancRefsMaster;
+            else
+                t->mergeNearTags(!goDown, c, i);
+        }
+    }
+    t->revOrder.clear();
+    t->revs.clear();
+    t->refs.clear();
+    t->tagDescs.clear();
+
+    if (*generation != id) {
+        delete t;
+        return NULL;
+    }
+    return t;
+}
+
+const QVector<int> TreeIndex::toOrderIdx(const RevBitmap& slots, const QVector<int>& slotIdx) const
+{
+    const QVector<uint> v(slots.toVector());
+    QVector<int> idx(v.count());
+    for (int i = 0; i < v.count(); i++)
+        idx[i] = slotIdx.at(v.at(i));
+
+    return idx;
+}
+
+const QVector<int> TreeIndex::descBranches(int idx) const
+{
+    int master = nodes.at(idx).descBrnMaster;
+    if (master == -1)
+        return QVector<int>();
+
+    return toOrderIdx(nodes.at(master).descBranches, branchIdx);
+}
+
+const QVector<int> TreeIndex::nearTags(bool goDown, int idx) const
+{
+    const Node& n = nodes.at(idx);
+    int master = (goDown ? n.descRefsMaster : n.ancRefsMaster);
+    if (master == -1)
+        return QVector<int>();
+
+    return toOrderIdx(goDown ? nodes.at(master).descRefs : nodes.at(master).ancRefs, tagIdx);
+}
+
+bool TreeIndex::mayBeAncestor(int idx, int ofIdx) const
+{
+    // false if idx is surely not an ancestor of ofIdx
+    const Node& a = nodes.at(idx);
+    const Node& r = nodes.at(ofIdx);
+    return idx > ofIdx && a.gen < r.gen && r.low <= a.low && a.post <= r.post;
+}
+
+bool TreeIndex::isAncestor(int idx, int ofIdx) const
+{
+    if (idx == ofIdx)
+        return true;
+
+    if (!mayBeAncestor(idx, ofIdx))
+        return false;
+
+    QVector<int> todo(1, ofIdx);
+    QSet<int> seen;
+    while (!todo.isEmpty()) {
+
+        const ArenaVector<int>& p = nodes.at(todo.last()).parents;
+        todo.pop_back();
+
+        for (int i = 0; i < p.count(); i++) {
+
+            if (p[i] == idx)
+                return true;
+
+            if (!seen.contains(p[i]) && mayBeAncestor(idx, p[i])) {
+                seen.insert(p[i]);
+                todo.append(p[i]);
+            }
+        }
+    }
+    return false;
+}
+
+int TreeIndex::mergeBase(int idx1, int idx2) const
+{
+    if (isAncestor(idx1, idx2))
+        return idx1;
+
+    if (isAncestor(idx2, idx1))
+        return idx2;
+
+    // paint ancestors of both in graph order, when a revision is
+    // reached all its loaded descendants have been already visited,
+    // so the first one reached from both sides is the nearest common
+    QMap<int, int> queue; // orderIdx -> sides it is reached from
+    queue.insert(idx1, 1);
+    queue.insert(idx2, 2);
+    while (!queue.isEmpty()) {
+
+        QMap<int, int>::iterator it(queue.begin());
+        int idx = it.key();
+        int sides = it.value();
+        queue.erase(it);
+
+        if (sides == 3)
+            return idx;
+
+        const ArenaVector<int>& p = nodes.at(idx).parents;
+        for (int i = 0; i < p.count(); i++)
+            queue[p[i]] |= sides;
+    }
+    return -1;
+}
+
+void TreeIndex::computePostOrder()
+{
+    // iterative DFS along parents, low starts as post
+    // and is lowered in the backward walk
+    int post = 0;
+    QVector<QPair<int, int> > stack; // (orderIdx, next parent)
+    for (int i = 0; i < nodes.count(); i++) {
+
+        if (nodes.at(i).post != -1)
+            continue;
+
+        nodes[i].post = -2; // on stack
+        stack.append(qMakePair(i, 0));
+        while (!stack.isEmpty()) {
+
+            int idx = stack.last().first;
+            const ArenaVector<int>& p = nodes.at(idx).parents;
+
+            if (stack.last().second < p.count()) {
+                int par = p[stack.last().second++];
+                if (nodes.at(par).post == -1) {
+                    nodes[par].post = -2;
+                    stack.append(qMakePair(par, 0));
+                }
+            } else {
+                nodes[idx].post = nodes[idx].low = post++;
+                stack.pop_back();
+            }
+        }
+    }
+}
+
+bool TreeIndex::isBranch(int idx) const
+{
+    return refs.checkRef(revOrder.at(idx), Reference::BRANCH | Reference::REMOTE_BRANCH);
+}
+
+bool TreeIndex::isTag(int idx) const
+{
+    return refs.checkRef(revOrder.at(idx), Reference::TAG);
+}
+
+bool TreeIndex::isDescendantTag(int slot, int ofSlot) const
+{
+    return tagDescs.at(ofSlot).contains(slot);
+}
+
+void TreeIndex::addTag(int idx)
+{
+/*
+   Tags are given slots in graph order, so the descendant tags of a
+   tag, that is its nearest descendant tags and all their descendants,
+   were already computed and their slots are lower. In a mostly linear
+   history these sets are long runs and are stored in few bytes.
+*/
+    Node& n = nodes[idx];
+    RevBitmap desc;
+    if (n.descRefsMaster != -1) {
+
+        const RevBitmap& nr = nodes.at(n.descRefsMaster).descRefs;
+        const QVector<uint> v(nr.toVector());
+        desc = nr;
+        for (int i = 0; i < v.count(); i++)
+            desc |= tagDescs.at(v.at(i));
+    }
+    n.tagSlot = tagIdx.count();
+    tagIdx.append(idx);
+    tagDescs.append(desc);
+
+    n.descRefs = RevBitmap();
+    n.descRefs.insert(n.tagSlot);
+}
+
+void TreeIndex::mergeBranches(int p, int r)
+{
+    Node& pn = nodes[p];
+    int r_descBrnMaster = (isBranch(r) ? r : nodes.at(r).descBrnMaster);
+
+    if (pn.descBrnMaster == r_descBrnMaster || r_descBrnMaster == -1)
+        return;
+
+    // we want all the descendant branches, union takes care of duplicates
+    RevBitmap dst(nodes.at(pn.descBrnMaster).descBranches);
+    dst |= nodes.at(r_descBrnMaster).descBranches;
+
+    pn.descBranches = dst;
+    pn.descBrnMaster = p;
+}
+
+void TreeIndex::mergeNearTags(bool down, int p, int r)
+{
+    Node& pn = nodes[p];
+    const Node& rn = nodes.at(r);
+    bool rIsTag = (rn.tagSlot != -1);
+    int r_descRefsMaster = rIsTag ? r : rn.descRefsMaster;
+    int r_ancRefsMaster = rIsTag ? r : rn.ancRefsMaster;
+
+    if (down && (pn.descRefsMaster == r_descRefsMaster || r_descRefsMaster == -1))
+        return;
+
+    if (!down && (pn.ancRefsMaster == r_ancRefsMaster || r_ancRefsMaster == -1))
+        return;
+
+    RevBitmap all(down ? nodes.at(pn.descRefsMaster).descRefs
+                       : nodes.at(pn.ancRefsMaster).ancRefs);
+    all |= (down ? nodes.at(r_descRefsMaster).descRefs
+                 : nodes.at(r_ancRefsMaster).ancRefs);
+
+    // we want the nearest tags only, so remove any tag that is a
+    // descendant (going down) or an ancestor (going up) of another
+    // tag in p U r. These sets are small, the lookups are cheap.
+    const QVector<uint> v(all.toVector());
+    RevBitmap nearRefs;
+    for (int s1 = 0; s1 < v.count(); s1++) {
+
+        bool isNear = true;
+        for (int s2 = 0; s2 < v.count() && isNear; s2++)
+            if (s1 != s2)
+                isNear = down ? !isDescendantTag(v[s1], v[s2])
+                              : !isDescendantTag(v[s2], v[s1]);
+        if (isNear)
+            nearRefs.insert(v[s1]);
+    }
+    (down ? pn.descRefs : pn.ancRefs) = nearRefs;
+    (down ? pn.descRefsMaster : pn.ancRefsMaster) = p;
+}
@@ -0,0 +1,89 @@
+#ifndef TREEINDEX_H
+#define TREEINDEX_H
+
+#include <QAtomicInt>
+#include <QVector>
+#include "revarena.h"
+#include "revbitmap.h"
+#include "revmap.h"
+#include "shamap.h"
+
+/*
+   Children, descendant branches and nearest tags of each revision,
+   indexed by orderIdx.
+
+   It is built by build() in a worker thread, walking a snapshot of the
+   loaded graph: revOrder, RevMap and ShaMap are implicitly shared copies
+   and revisions are only read. Once published it is never modified, so
+   it can be read from GUI thread without locking. A build is tagged with
+   the generation it was started for, bumping the generation cancels it.
+
+   Branches and tags are numbered in slots following graph order and
+   sets of them are RevBitmap of slots, ancestry among tags is a bitmap
+   of descendant tags per tag, so memory stays bounded also in repos
+   with many thousands of tags.
+
+   Ancestry queries are answered in memory: a revision can be ancestor
+   of another only if it comes later in graph order, has a lower
+   generation number and its DFS interval [low, post] is contained in
+   the other's one. These checks reject almost all the unrelated pairs
+   in constant time and prune the walk along parents for the others.
+*/
+class TreeIndex
+{
+public:
+    static TreeIndex* build(const ShaVect& revOrder, const RevMap& revs, const ShaMap& refs,
+                            bool goDown, const QAtomicInt* generation);
+
+    int generation() const { return buildId; }
+    const ArenaVector<int>& childs(int idx) const { return nodes.at(idx).childs; }
+    const QVector<int> descBranches(int idx) const;
+    const QVector<int> nearTags(bool goDown, int idx) const;
+    bool isAncestor(int idx, int ofIdx) const;
+    int mergeBase(int idx1, int idx2) const; // -1 if none
+
+private:
+    TreeIndex(const ShaVect& ro, const RevMap& r, const ShaMap& sm);
+    TreeIndex(const TreeIndex&);
+    TreeIndex& operator=(const TreeIndex&);
+
+    struct Node
+    {
+        Node() : tagSlot(-1), descRefsMaster(-1), ancRefsMaster(-1), descBrnMaster(-1),
+                 gen(1), post(-1), low(-1) {}
+
+        ArenaVector<int> childs;
+        ArenaVector<int> parents; // only the loaded ones
+        RevBitmap descRefs;     // descendant tags slots
+        RevBitmap ancRefs;      // ancestor tags slots
+        RevBitmap descBranches; // descendant branches slots
+        int tagSlot;
+        int descRefsMaster; // in case of many Rev have the same descRefs, ancRefs or
+        int ancRefsMaster;  // descBranches these are stored only once in a Rev pointed
+        int descBrnMaster;  // by corresponding index xxxMaster
+        int gen;  // generation, 1 + max generation of parents
+        int post; // DFS post order along parents
+        int low;  // lowest post order among ancestors
+    };
+    bool isBranch(int idx) const;
+    bool isTag(int idx) const;
+    bool isDescendantTag(int slot, int ofSlot) const;
+    bool mayBeAncestor(int idx, int ofIdx) const;
+    void computePostOrder();
+    void addTag(int idx);
+    void mergeNearTags(bool down, int p, int r);
+    void mergeBranches(int p, int r);
+    const QVector<int> toOrderIdx(const RevBitmap& slots, const QVector<int>& slotIdx) const;
+
+    int buildId; // generation the index was built for
+    ShaVect revOrder; // graph snapshot, released at the end of build()
+    RevMap revs;
+    ShaMap refs;
+    RevArena arena;
+    QVector<Node> nodes;
+    QVector<int> branchIdx; // slot -> orderIdx
+    QVector<int> tagIdx;
+    QVector<RevBitmap> tagDescs; // tag slot -> all descendant tags, only while building
+};
+
+#endif // TREEINDEX_H
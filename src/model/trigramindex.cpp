@@ -0,0 +1,102 @@
+#include "trigramindex.h"
+
+static inline uchar lower(uchar c) {
+
+    return (c >= 'A' && c <= 'Z' ? uchar(c + 'a' - 'A') : c);
+}
+
+void TrigramIndex::clear()
+{
+    postings.clear();
+    indexedCnt = 0;
+}
+
+void TrigramIndex::add(const QByteArray& text)
+{
+    // non ASCII bytes are indexed as they are, queries never ask for them
+    const uint unit = uint(indexedCnt++) >> blockShift;
+    const uchar* p = (const uchar*)text.constData();
+    quint32 t = 0;
+    for (int i = 0; i < text.size(); i++) {
+
+        t = ((t << 8) | lower(p[i])) & 0xFFFFFF;
+        if (i >= 2)
+            postings[t].insert(unit); // repeated ones are ignored
+    }
+}
+
+void TrigramIndex::trigrams(const QString& wildcard, QVector<quint32>& v)
+{
+/*
+   Only runs of literal ASCII characters give trigrams, anything that
+   could match more than one character breaks the run, as '*', '?' or
+   a [...] set. Escapes are treated as wildcards too, it's just fewer
+   trigrams.
+*/
+    v.clear();
+    quint32 t = 0;
+    int runLen = 0, setStart = -1;
+    for (int i = 0; i < wildcard.length(); i++) {
+
+        const ushort c = wildcard.at(i).unicode();
+        if (setStart != -1) {
+            // a ']' just after '[' or '[!' is a literal in the set
+            const QChar prev(wildcard.at(i - 1));
+            bool isFirst = (   i == setStart + 1
+                            || (i == setStart + 2 && (prev == '!' || prev == '^')));
+            if (c == ']' && !isFirst)
+                setStart = -1;
+            continue;
+        }
+        if (c == '[')
+            setStart = i;
+
+        if (c == '*' || c == '?' || c == '[' || c == '\\' || c >= 128) {
+            runLen = 0;
+            continue;
+        }
+        t = ((t << 8) | lower(uchar(c))) & 0xFFFFFF;
+        if (++runLen >= 3)
+            v.append(t);
+    }
+}
+
+bool TrigramIndex::candidates(const QString& wildcard, QVector<int>& revs) const
+{
+    // returns false if the pattern has no trigrams, so no narrowing is possible
+    QVector<quint32> tris;
+    trigrams(wildcard, tris);
+    if (tris.isEmpty())
+        return false;
+
+    revs.clear();
+    QVector<const RevBitmap*> lists;
+    int rarest = 0;
+    for (int i = 0; i < tris.count(); i++) {
+
+        QHash<quint32, RevBitmap>::const_iterator it(postings.constFind(tris.at(i)));
+        if (it == postings.constEnd())
+            return true; // no revision can match
+
+        lists.append(&(*it));
+        if (lists.last()->count() < lists.at(rarest)->count())
+            rarest = lists.count() - 1;
+    }
+    // walk the shortest list, the others are just looked up
+    const QVector<uint> units(lists.at(rarest)->toVector());
+    for (int i = 0; i < units.count(); i++) {
+
+        bool all = true;
+        for (int j = 0; j < lists.count() && all; j++)
+            all = (j == rarest || lists.at(j)->contains(units.at(i)));
+
+        if (!all)
+            continue;
+
+        int first = int(units.at(i) << blockShift);
+        int last = qMin(int((units.at(i) + 1) << blockShift), indexedCnt);
+        for (int r = first; r < last; r++)
+            revs.append(r);
+    }
+    return true;
+}
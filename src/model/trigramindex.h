@@ -0,0 +1,38 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "revbitmap.h"
+
+/*
+   Trigram index of a revision text field, as subject or author, used
+   to narrow the revisions a wildcard filter must be matched against.
+
+   Revisions are added in graph order and each trigram of the lower
+   cased ASCII text lists the revisions it is found in. With a block
+   shift greater than zero trigrams list blocks of consecutive
+   revisions instead, that keeps long texts index small at the cost of
+   some more candidates. Candidates must be verified by the caller, the
+   index only guarantees there are no false negatives.
+*/
+class TrigramIndex
+{
+public:
+    explicit TrigramIndex(int shift = 0) : blockShift(shift), indexedCnt(0) {}
+    void clear();
+    int count() const { return indexedCnt; } // next orderIdx to add
+    void add(const QByteArray& text);
+    bool candidates(const QString& wildcard, QVector<int>& revs) const;
+
+private:
+    static void trigrams(const QString& wildcard, QVector<quint32>& v);
+
+    int blockShift;
+    int indexedCnt;
+    QHash<quint32, RevBitmap> postings; // trigram -> revisions or blocks
+};
+
+#endif // TRIGRAMINDEX_H
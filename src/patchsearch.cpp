@@ -0,0 +1,57 @@
+/*
+    Description: streaming pickaxe search of revisions patches
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#include "git.h"
+#include "myprocess.h"
+#include "patchsearch.h"
+
+PatchSearch::PatchSearch(Git* g) : QObject(g), git(g) {}
+
+bool PatchSearch::start(SCRef exp, bool isRegExp, SCRef shaList) {
+
+    QString runCmd("git diff-tree --no-color -r -s --stdin ");
+    if (isRegExp)
+        runCmd.append("--pickaxe-regex ");
+
+    runCmd.append(Git::quote("-S" + exp));
+    proc = git->runAsync(runCmd, this, shaList);
+    return (proc != NULL);
+}
+
+void PatchSearch::cancel() {
+
+    git->cancelProcess(proc); // NULL if already finished
+    deleteLater();
+}
+
+void PatchSearch::procReadyRead(const QByteArray& chunk) {
+
+    pending.append(chunk);
+    int pos = pending.lastIndexOf('\n');
+    if (pos == -1)
+        return;
+
+    // output is just the matching shas, one per line
+    const QList<QByteArray> lines(pending.left(pos).split('\n'));
+    pending.remove(0, pos + 1);
+
+    QStringList shas;
+    FOREACH (QList<QByteArray>, it, lines)
+        if ((*it).size() == 40)
+            shas.append(QString::fromLatin1(*it));
+
+    if (!shas.isEmpty())
+        emit found(shas);
+}
+
+void PatchSearch::procFinished() {
+
+    if (pending.size() == 40)
+        emit found(QStringList(QString::fromLatin1(pending)));
+
+    emit done();
+    deleteLater();
+}
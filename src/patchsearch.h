@@ -0,0 +1,39 @@
+#ifndef PATCHSEARCH_H
+#define PATCHSEARCH_H
+
+#include <QPointer>
+#include <QStringList>
+#include "common.h"
+
+class Git;
+class MyProcess;
+
+/*
+   Runs one 'git diff-tree -S' (pickaxe) over a range of revisions and
+   reports the matching ones as soon as they are printed, so that the
+   caller can show partial results. Git runs a few of them in parallel,
+   see Git::startPatchFilter().
+*/
+class PatchSearch : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PatchSearch(Git* g);
+    bool start(SCRef exp, bool isRegExp, SCRef shaList);
+    void cancel();
+
+signals:
+    void found(const QStringList&);
+    void done();
+
+private slots:
+    void procReadyRead(const QByteArray&);
+    void procFinished();
+
+private:
+    Git* git;
+    QPointer<MyProcess> proc;
+    QByteArray pending; // last line, could be not complete
+};
+
+#endif
@@ -5,12 +5,12 @@ GIT_EXEC_DIR = "$(ProgramFiles)\\Git\\bin"
 # Under Windows uncomment following line to enable console messages
 #CONFIG += ENABLE_CONSOLE_MSG
 
-# check for Qt >= 4.3.0
+# check for Qt >= 4.4.0, QtConcurrent is used
 CUR_QT = $$[QT_VERSION]
 
 # WARNING greaterThan is an undocumented function
-!greaterThan(CUR_QT, 4.3) {
-    error("Sorry I need Qt 4.3.0 or later, you seem to have Qt $$CUR_QT instead")
+!greaterThan(CUR_QT, 4.4) {
+    error("Sorry I need Qt 4.4.0 or later, you seem to have Qt $$CUR_QT instead")
 }
 
 # check for g++ compiler
@@ -75,9 +75,9 @@ FORMS += commit.ui console.ui customaction.ui fileview.ui help.ui \
     ui/rangeselect.ui
 
 HEADERS += annotate.h cache.h commitimpl.h common.h config.h consoleimpl.h \
-           customactionimpl.h dataloader.h domain.h exceptionmanager.h \
+           customactionimpl.h dataloader.h difftreeloader.h domain.h exceptionmanager.h \
            filecontent.h filelist.h fileview.h git.h help.h lanes.h \
-           listview.h mainimpl.h myprocess.h patchcontent.h patchview.h \
+           listview.h mainimpl.h myprocess.h patchcontent.h patchsearch.h patchview.h \
             revdesc.h revsview.h settingsimpl.h \
            treeview.h \
     branchestree.h \
@@ -96,19 +96,28 @@ HEADERS += annotate.h cache.h commitimpl.h common.h config.h consoleimpl.h \
     filehistory.h \
     listviewproxy.h \
     listviewdelegate.h \
+    lz4codec.h \
     ui/rangeselectimpl.h \
     ui/customtabwidget.h \
     ui/customtab.h \
     model/shastring.h \
     model/revision.h \
+    model/revmap.h \
+    model/revarena.h \
+    model/revbitmap.h \
+    model/pathtrie.h \
+    model/bytescan.h \
+    model/revquery.h \
+    model/trigramindex.h \
+    model/treeindex.h \
     model/shamap.h
 
 
 SOURCES += annotate.cpp cache.cpp commitimpl.cpp consoleimpl.cpp \
-           customactionimpl.cpp dataloader.cpp domain.cpp exceptionmanager.cpp \
+           customactionimpl.cpp dataloader.cpp difftreeloader.cpp domain.cpp exceptionmanager.cpp \
            filecontent.cpp filelist.cpp fileview.cpp git.cpp \
            lanes.cpp listview.cpp mainimpl.cpp myprocess.cpp namespace_def.cpp \
-           patchcontent.cpp patchview.cpp  \
+           patchcontent.cpp patchsearch.cpp patchview.cpp  \
            revdesc.cpp revsview.cpp settingsimpl.cpp treeview.cpp \
     branchestree.cpp \
     main.cpp \
@@ -127,11 +136,20 @@ SOURCES += annotate.cpp cache.cpp commitimpl.cpp consoleimpl.cpp \
     filehistory.cpp \
     listviewproxy.cpp \
     listviewdelegate.cpp \
+    lz4codec.cpp \
     ui/rangeselectimpl.cpp \
     ui/customtabwidget.cpp \
     ui/customtab.cpp \
     model/shastring.cpp \
     model/revision.cpp \
+    model/revmap.cpp \
+    model/revarena.cpp \
+    model/revbitmap.cpp \
+    model/pathtrie.cpp \
+    model/bytescan.cpp \
+    model/revquery.cpp \
+    model/trigramindex.cpp \
+    model/treeindex.cpp \
     model/shamap.cpp
 
 DISTFILES += app_icon.rc helpgen.sh resources/* Src.vcproj todo.txt